@@ -0,0 +1,360 @@
+/* Cathal O Broin - cathal.obroin4 at mail.dcu.ie - 2015
+   This work is not developed in affiliation with any organisation.
+
+   This file is part of AILM.
+
+   AILM is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   AILM is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with AILM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CATHAL_LA_EIGEN_GUARD
+#define CATHAL_LA_EIGEN_GUARD
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include "util/error.h"
+#include "numeric/type.h"
+#include "la/array.h"
+#include "la/factor.h"
+namespace cathal
+{
+namespace la
+{
+/* ***************************************************
+ *
+ *          Dense Linear Algebra Routines
+ *      -Products, Symmetric Eigenproblems-
+ * ***************************************************/
+//Tile size for the blocked products, three tiles of doubles fit in a typical L2 cache.
+const size_t TileSize = 64;
+
+//C = A * B, or A^T * B when TransA is set. Tiled so the rows of B and C being worked on stay in cache.
+template <class T>
+void Gemm(fullblock<T> & A, fullblock<T> & B, fullblock<T> & C, bool TransA = false)
+{
+    size_t N = (TransA ? A.Column() : A.Row());
+    size_t K = (TransA ? A.Row() : A.Column());
+    size_t M = B.Column();
+    if (K != B.Row())
+    {
+        DP();
+        throw(SIZE_MISMATCH);
+    }
+    C.Resize(N, M);
+    if (N*M == 0)
+        return;
+    T * c = &C(0);
+    std::fill(c, c + N*M, T(0));
+    if (K == 0)
+        return;
+    const T * a = &A(0);
+    const T * b = &B(0);
+    size_t Lda = A.Column();
+
+    int NumTiles = (N + TileSize - 1) / TileSize;
+#pragma omp parallel for shared(a, b, c) firstprivate(N, K, M, Lda, TransA, NumTiles) default(none) schedule(dynamic) if(N*M*K > 1000000)
+    for (int t = 0; t < NumTiles; t++)
+    {
+        size_t ii = t * TileSize;
+        for (size_t kk = 0; kk < K; kk += TileSize)
+            for (size_t jj = 0; jj < M; jj += TileSize)
+                for (size_t i = ii; i < std::min(ii + TileSize, N); i++)
+                {
+                    T * Ci = c + i*M;
+                    for (size_t q = kk; q < std::min(kk + TileSize, K); q++)
+                    {
+                        T Aiq = (TransA ? a[q*Lda + i] : a[i*Lda + q]);
+                        const T * Bq = b + q*M;
+                        for (size_t j = jj; j < std::min(jj + TileSize, M); j++)
+                            Ci[j] += Aiq * Bq[j];
+                    }
+                }
+    }
+}
+//C = A * B for a banded A, only the 2k-1 rows of B in the band are touched for each row of C.
+template <class T>
+void Gemm(band<T> & A, fullblock<T> & B, fullblock<T> & C)
+{
+    int N = A.Row();
+    int M = B.Column();
+    int k = A.Order();
+    if (A.Column() != B.Row())
+    {
+        DP();
+        throw(SIZE_MISMATCH);
+    }
+    C.Resize(N, M);
+    if (N*M == 0)
+        return;
+    std::fill(&C(0), &C(0) + N*M, T(0));
+
+#pragma omp parallel for shared(A, B, C) firstprivate(N, M, k) default(none)
+    for (int i = 0; i < N; i++)
+    {
+        T * Ci = &C(i, 0);
+        for (int q = std::max(0, i-k+1); q < std::min(N, i+k); q++)
+        {
+            T Aiq = A(i, q);
+            const T * Bq = &B(q, 0);
+            for (int j = 0; j < M; j++)
+                Ci[j] += Aiq * Bq[j];
+        }
+    }
+}
+
+//Householder reduction of a symmetric matrix to tridiagonal form, V is overwritten by the transformation.
+//After the EISPACK tred2 routine (via the public domain JAMA version).
+template <class T>
+void Tridiagonalise(fullblock<T> & V, std::vector<T> & d, std::vector<T> & e)
+{
+    int n = V.Row();
+    d.resize(n);
+    e.resize(n);
+    for (int j = 0; j < n; j++)
+        d[j] = V(n-1, j);
+
+    for (int i = n-1; i > 0; i--)
+    {
+        T Scale = T(0), h = T(0);
+        for (int k = 0; k < i; k++)
+            Scale += std::abs(d[k]);
+        if (Scale == T(0))
+        {
+            e[i] = d[i-1];
+            for (int j = 0; j < i; j++)
+            {
+                d[j] = V(i-1, j);
+                V(i, j) = V(j, i) = T(0);
+            }
+        }
+        else
+        {
+            for (int k = 0; k < i; k++)
+            {
+                d[k] /= Scale;
+                h += d[k] * d[k];
+            }
+            T f = d[i-1];
+            T g = std::sqrt(h);
+            if (f > 0)
+                g = -g;
+            e[i] = Scale * g;
+            h -= f * g;
+            d[i-1] = f - g;
+            for (int j = 0; j < i; j++)
+                e[j] = T(0);
+
+            for (int j = 0; j < i; j++)
+            {
+                f = d[j];
+                V(j, i) = f;
+                g = e[j] + V(j, j) * f;
+                for (int k = j+1; k <= i-1; k++)
+                {
+                    g += V(k, j) * d[k];
+                    e[k] += V(k, j) * f;
+                }
+                e[j] = g;
+            }
+            f = T(0);
+            for (int j = 0; j < i; j++)
+            {
+                e[j] /= h;
+                f += e[j] * d[j];
+            }
+            T hh = f / (h + h);
+            for (int j = 0; j < i; j++)
+                e[j] -= hh * d[j];
+            for (int j = 0; j < i; j++)
+            {
+                f = d[j];
+                g = e[j];
+                for (int k = j; k <= i-1; k++)
+                    V(k, j) -= (f * e[k] + g * d[k]);
+                d[j] = V(i-1, j);
+                V(i, j) = T(0);
+            }
+        }
+        d[i] = h;
+    }
+
+    //Accumulate the transformations.
+    for (int i = 0; i < n-1; i++)
+    {
+        V(n-1, i) = V(i, i);
+        V(i, i) = T(1);
+        T h = d[i+1];
+        if (h != T(0))
+        {
+            for (int k = 0; k <= i; k++)
+                d[k] = V(k, i+1) / h;
+            for (int j = 0; j <= i; j++)
+            {
+                T g = T(0);
+                for (int k = 0; k <= i; k++)
+                    g += V(k, i+1) * V(k, j);
+                for (int k = 0; k <= i; k++)
+                    V(k, j) -= g * d[k];
+            }
+        }
+        for (int k = 0; k <= i; k++)
+            V(k, i+1) = T(0);
+    }
+    for (int j = 0; j < n; j++)
+    {
+        d[j] = V(n-1, j);
+        V(n-1, j) = T(0);
+    }
+    V(n-1, n-1) = T(1);
+    e[0] = T(0);
+}
+
+//Implicit QL iterations on the tridiagonal matrix, after EISPACK tql2. The eigenvalues come out in d in
+//ascending order and the columns of V (from Tridiagonalise) become the eigenvectors. Rows of V are rotated
+//independently, so V may hold only the rows wanted (e.g. the last one, for Lanczos residuals) or none at all.
+template <class T>
+void TridiagonalQL(std::vector<T> & d, std::vector<T> & e, fullblock<T> & V)
+{
+    int n = d.size();
+    int Rows = V.Row();
+    if (n == 0)
+        return;
+    for (int i = 1; i < n; i++)
+        e[i-1] = e[i];
+    e[n-1] = T(0);
+
+    T f = T(0), Tst = T(0);
+    T Eps = std::numeric_limits<T>::epsilon();
+    for (int l = 0; l < n; l++)
+    {
+        Tst = std::max(Tst, std::abs(d[l]) + std::abs(e[l]));
+        int m = l;
+        while (m < n-1 && std::abs(e[m]) > Eps * Tst)
+            m++;
+
+        int Iter = 0;
+        if (m > l)
+            do
+            {
+                if (++Iter > 60)
+                    throw(NOT_CONVERGED);
+                T g = d[l];
+                T p = (d[l+1] - g) / (T(2) * e[l]);
+                T r = std::hypot(p, T(1));
+                if (p < 0)
+                    r = -r;
+                d[l] = e[l] / (p + r);
+                d[l+1] = e[l] * (p + r);
+                T dl1 = d[l+1];
+                T h = g - d[l];
+                for (int i = l+2; i < n; i++)
+                    d[i] -= h;
+                f += h;
+
+                p = d[m];
+                T c = T(1), c2 = c, c3 = c;
+                T el1 = e[l+1];
+                T s = T(0), s2 = T(0);
+                for (int i = m-1; i >= l; i--)
+                {
+                    c3 = c2;
+                    c2 = c;
+                    s2 = s;
+                    g = c * e[i];
+                    h = c * p;
+                    r = std::hypot(p, e[i]);
+                    e[i+1] = s * r;
+                    s = e[i] / r;
+                    c = p / r;
+                    p = c * d[i] - s * g;
+                    d[i+1] = h + s * (c * g + s * d[i]);
+                    for (int k = 0; k < Rows; k++)
+                    {
+                        h = V(k, i+1);
+                        V(k, i+1) = s * V(k, i) + c * h;
+                        V(k, i) = c * V(k, i) - s * h;
+                    }
+                }
+                p = -s * s2 * c3 * el1 * e[l] / dl1;
+                e[l] = s * p;
+                d[l] = c * p;
+            }
+            while (std::abs(e[l]) > Eps * Tst);
+        d[l] += f;
+        e[l] = T(0);
+    }
+
+    for (int i = 0; i < n-1; i++)
+    {
+        int m = std::min_element(d.begin() + i, d.end()) - d.begin();
+        if (m != i)
+        {
+            std::swap(d[i], d[m]);
+            for (int j = 0; j < Rows; j++)
+                std::swap(V(j, i), V(j, m));
+        }
+    }
+}
+
+//Dense symmetric eigenproblem, A is overwritten with the eigenvectors (as columns).
+template <class T>
+std::vector<T> SymEigen(fullblock<T> & A)
+{
+    std::vector<T> d, e;
+    Tridiagonalise(A, d, e);
+    TridiagonalQL(d, e, A);
+    return d;
+}
+
+//H C = S C E for symmetric banded H and positive definite banded S, reduced to standard form with the banded
+//Cholesky factor of S. The eigenvectors are S-orthonormal, C^T S C = I.
+template <class T>
+std::vector<T> GenSymEigen(band<T> & H, band<T> & S, fullblock<T> & C)
+{
+    int N = H.Row();
+    int k = H.Order();
+    if (S.Row() != H.Row())
+    {
+        DP();
+        throw(SIZE_MISMATCH);
+    }
+    C.Resize(N, N);
+    if (N == 0)
+        return std::vector<T>();
+
+    cholesky<T> Chol(S);
+    fullblock<T> A(N, N);
+    for (int i = 0; i < N; i++)
+        for (int j = std::max(0, i-k+1); j < std::min(N, i+k); j++)
+            A(i, j) = H(i, j);
+
+    //A = L^-1 H L^-T, two forward substitutions with a transpose between them.
+    T * a = &A(0);
+    for (int Pass = 0; Pass < 2; Pass++)
+    {
+        Chol.SolveL(a, N);
+        for (int i = 0; i < N; i++)
+            for (int j = i+1; j < N; j++)
+                std::swap(a[i*N + j], a[j*N + i]);
+    }
+
+    std::vector<T> E = SymEigen(A);
+
+    //C = L^-T Y
+    std::copy(a, a + N*N, &C(0));
+    Chol.SolveLT(&C(0), N);
+    return E;
+}
+}
+}
+#endif
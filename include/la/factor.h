@@ -0,0 +1,368 @@
+/* Cathal O Broin - cathal.obroin4 at mail.dcu.ie - 2015
+   This work is not developed in affiliation with any organisation.
+
+   This file is part of AILM.
+
+   AILM is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   AILM is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with AILM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CATHAL_LA_FACTOR_GUARD
+#define CATHAL_LA_FACTOR_GUARD
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "util/error.h"
+#include "numeric/type.h"
+#include "la/array.h"
+#include "la/slice.h"
+namespace cathal
+{
+namespace la
+{
+/* ***************************************************
+ *
+ *          Banded Factorisations
+ *      -Cholesky, LDL^T and LU, factor once, solve many-
+ * ***************************************************/
+/*
+    The factors are kept in the band storage layout, row i holds columns i-k+1 to i+k-1 at (2i+1)(k-1)+j, and only
+    the lower half is used. Right hand sides are N x NRhs row-major blocks (a slice is NRhs = 1). The substitutions
+    run over RhsTile columns at a time so the k rows of the right hand side in use stay in cache.
+*/
+const size_t RhsTile = 64;
+
+template <class T>
+class bandfactor
+{
+    protected :
+    int N, k;
+    std::vector<T> F;
+    T & At(int i, int j)
+    {
+        return F[(i*2+1)*(k-1) + j];
+    }
+    bandfactor(band<T> & A) : N(A.Row()), k(A.Order()), F(A.NumElem())
+    {
+        if (N)
+            std::copy(&A(0), &A(0) + A.NumElem(), F.begin());
+    }
+    //L y = b, with a unit diagonal when Unit is set.
+    void Forward(T * B, size_t NRhs, bool Unit)
+    {
+        for (size_t c0 = 0; c0 < NRhs; c0 += RhsTile)
+        {
+            size_t c1 = std::min(NRhs, c0 + RhsTile);
+            for (int i = 0; i < N; i++)
+            {
+                T * Bi = B + i*NRhs;
+                for (int q = std::max(0, i-k+1); q < i; q++)
+                {
+                    T Liq = At(i, q);
+                    const T * Bq = B + q*NRhs;
+                    for (size_t c = c0; c < c1; c++)
+                        Bi[c] -= Liq * Bq[c];
+                }
+                if (!Unit)
+                {
+                    T Inv = T(1) / At(i, i);
+                    for (size_t c = c0; c < c1; c++)
+                        Bi[c] *= Inv;
+                }
+            }
+        }
+    }
+    //L^T x = y, with a unit diagonal when Unit is set.
+    void Backward(T * B, size_t NRhs, bool Unit)
+    {
+        for (size_t c0 = 0; c0 < NRhs; c0 += RhsTile)
+        {
+            size_t c1 = std::min(NRhs, c0 + RhsTile);
+            for (int i = N-1; i >= 0; i--)
+            {
+                T * Bi = B + i*NRhs;
+                for (int q = i+1; q < std::min(N, i+k); q++)
+                {
+                    T Lqi = At(q, i);
+                    const T * Bq = B + q*NRhs;
+                    for (size_t c = c0; c < c1; c++)
+                        Bi[c] -= Lqi * Bq[c];
+                }
+                if (!Unit)
+                {
+                    T Inv = T(1) / At(i, i);
+                    for (size_t c = c0; c < c1; c++)
+                        Bi[c] *= Inv;
+                }
+            }
+        }
+    }
+
+    public :
+    size_t Row()
+    {
+        return N;
+    }
+    int Order()
+    {
+        return k;
+    }
+};
+
+//A = L L^T for symmetric positive definite A.
+template <class T>
+class cholesky : public bandfactor<T>
+{
+    using bandfactor<T>::N;
+    using bandfactor<T>::k;
+    using bandfactor<T>::At;
+
+    public :
+    cholesky(band<T> & A) : bandfactor<T>(A)
+    {
+        for (int i = 0; i < N; i++)
+            for (int j = std::max(0, i-k+1); j <= i; j++)
+            {
+                T Sum = At(i, j);
+                for (int q = std::max(0, i-k+1); q < j; q++)
+                    Sum -= At(i, q) * At(j, q);
+                if (i == j)
+                {
+                    if (!(Sum > T(0)))
+                        throw(NOT_POSITIVE_DEFINITE);
+                    At(i, i) = std::sqrt(Sum);
+                }
+                else
+                    At(i, j) = Sum / At(j, j);
+            }
+    }
+    T & L(int i, int j)
+    {
+        return At(i, j);
+    }
+    //B = L^-1 B and B = L^-T B, the halves of a solve for reducing eigenproblems to standard form.
+    void SolveL(T * B, size_t NRhs)
+    {
+        this->Forward(B, NRhs, false);
+    }
+    void SolveLT(T * B, size_t NRhs)
+    {
+        this->Backward(B, NRhs, false);
+    }
+    //B = A^-1 B
+    void Solve(T * B, size_t NRhs)
+    {
+        SolveL(B, NRhs);
+        SolveLT(B, NRhs);
+    }
+    void Solve(fullblock<T> & B)
+    {
+        if (B.Row() != size_t(N))
+            throw(SIZE_MISMATCH);
+        if (B.NumElem())
+            Solve(&B(0), B.Column());
+    }
+    slice<T> Solve(slice<T> B)
+    {
+        slice<T> X(B.Size());
+        if (B.Size() != size_t(N))
+            throw(SIZE_MISMATCH);
+        std::copy(B.begin(), B.end(), X.begin());
+        if (N)
+            Solve(&*X.begin(), 1);
+        return X;
+    }
+};
+
+//A = L D L^T with unit L, for symmetric A that need not be definite (no pivoting, so it relies on the leading
+//minors being non-singular). Inertia() is the number of negative pivots, the Sturm count used for slicing.
+template <class T>
+class ldlt : public bandfactor<T>
+{
+    using bandfactor<T>::N;
+    using bandfactor<T>::k;
+    using bandfactor<T>::At;
+    std::vector<T> Work;
+
+    public :
+    ldlt(band<T> & A) : bandfactor<T>(A), Work(A.Order())
+    {
+        for (int i = 0; i < N; i++)
+        {
+            int Lo = std::max(0, i-k+1);
+            //Work holds L(i, q) D(q) for the row.
+            for (int j = Lo; j < i; j++)
+            {
+                T Sum = At(i, j);
+                for (int q = Lo; q < j; q++)
+                    Sum -= Work[q-Lo] * At(j, q);
+                Work[j-Lo] = Sum;
+                At(i, j) = Sum / At(j, j);
+            }
+            T Diag = At(i, i);
+            for (int q = Lo; q < i; q++)
+                Diag -= Work[q-Lo] * At(i, q);
+            if (Diag == T(0))
+                throw(SINGULAR);
+            At(i, i) = Diag;
+        }
+    }
+    T D(int i)
+    {
+        return At(i, i);
+    }
+    size_t Inertia()
+    {
+        size_t Neg = 0;
+        for (int i = 0; i < N; i++)
+            if (std::real(At(i, i)) < 0)
+                Neg++;
+        return Neg;
+    }
+    void Solve(T * B, size_t NRhs)
+    {
+        this->Forward(B, NRhs, true);
+        for (int i = 0; i < N; i++)
+        {
+            T Inv = T(1) / At(i, i);
+            for (size_t c = 0; c < NRhs; c++)
+                B[i*NRhs + c] *= Inv;
+        }
+        this->Backward(B, NRhs, true);
+    }
+    void Solve(fullblock<T> & B)
+    {
+        if (B.Row() != size_t(N))
+            throw(SIZE_MISMATCH);
+        if (B.NumElem())
+            Solve(&B(0), B.Column());
+    }
+    slice<T> Solve(slice<T> B)
+    {
+        slice<T> X(B.Size());
+        if (B.Size() != size_t(N))
+            throw(SIZE_MISMATCH);
+        std::copy(B.begin(), B.end(), X.begin());
+        if (N)
+            Solve(&*X.begin(), 1);
+        return X;
+    }
+};
+
+//P A = L U with partial pivoting inside the band, for general (e.g. complex non-Hermitian) banded A. Pivoting lets
+//U fill in to 2(k-1) super-diagonals, so rows are stored with k-1 multipliers and 2(k-1)+1 entries of U.
+template <class T>
+class bandlu
+{
+    int N, Kl, Ku, W;
+    std::vector<T> F;
+    std::vector<int> Piv;
+    T & At(int i, int j)
+    {
+        return F[i*W + j - i + Kl];
+    }
+
+    public :
+    bandlu(band<T> & A) : N(A.Row()), Kl(A.Order()-1), Ku(2*(A.Order()-1)), W(3*A.Order()-2), F(A.Row()*(3*A.Order()-2)), Piv(A.Row())
+    {
+        int k = A.Order();
+        for (int i = 0; i < N; i++)
+            for (int j = std::max(0, i-k+1); j < std::min(N, i+k); j++)
+                At(i, j) = A(i, j);
+
+        for (int j = 0; j < N; j++)
+        {
+            int Last = std::min(N, j+Kl+1);
+            int p = j;
+            for (int r = j+1; r < Last; r++)
+                if (std::abs(At(r, j)) > std::abs(At(p, j)))
+                    p = r;
+            if (At(p, j) == T(0))
+                throw(SINGULAR);
+            Piv[j] = p;
+            int End = std::min(N, j+Ku+1);
+            if (p != j)
+                for (int c = j; c < End; c++)
+                    std::swap(At(j, c), At(p, c));
+
+            T Inv = T(1) / At(j, j);
+            for (int r = j+1; r < Last; r++)
+            {
+                T m = At(r, j) * Inv;
+                At(r, j) = m;
+                if (m == T(0))
+                    continue;
+                for (int c = j+1; c < End; c++)
+                    At(r, c) -= m * At(j, c);
+            }
+        }
+    }
+    size_t Row()
+    {
+        return N;
+    }
+    void Solve(T * B, size_t NRhs)
+    {
+        for (size_t c0 = 0; c0 < NRhs; c0 += RhsTile)
+        {
+            size_t c1 = std::min(NRhs, c0 + RhsTile);
+            for (int j = 0; j < N; j++)
+            {
+                T * Bj = B + j*NRhs;
+                if (Piv[j] != j)
+                    for (size_t c = c0; c < c1; c++)
+                        std::swap(Bj[c], B[Piv[j]*NRhs + c]);
+                for (int r = j+1; r < std::min(N, j+Kl+1); r++)
+                {
+                    T m = At(r, j);
+                    T * Br = B + r*NRhs;
+                    for (size_t c = c0; c < c1; c++)
+                        Br[c] -= m * Bj[c];
+                }
+            }
+            for (int i = N-1; i >= 0; i--)
+            {
+                T * Bi = B + i*NRhs;
+                for (int q = i+1; q < std::min(N, i+Ku+1); q++)
+                {
+                    T Uiq = At(i, q);
+                    const T * Bq = B + q*NRhs;
+                    for (size_t c = c0; c < c1; c++)
+                        Bi[c] -= Uiq * Bq[c];
+                }
+                T Inv = T(1) / At(i, i);
+                for (size_t c = c0; c < c1; c++)
+                    Bi[c] *= Inv;
+            }
+        }
+    }
+    void Solve(std::vector<T> & B)
+    {
+        if (B.size() != size_t(N))
+            throw(SIZE_MISMATCH);
+        if (N)
+            Solve(&B[0], 1);
+    }
+    slice<T> Solve(slice<T> B)
+    {
+        slice<T> X(B.Size());
+        if (B.Size() != size_t(N))
+            throw(SIZE_MISMATCH);
+        std::copy(B.begin(), B.end(), X.begin());
+        if (N)
+            Solve(&*X.begin(), 1);
+        return X;
+    }
+};
+}
+}
+#endif
@@ -19,8 +19,14 @@
 #ifndef CATHAL_KRYLOV_GUARD
 #define CATHAL_KRYLOV_GUARD
 #include <vector>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
 #include "la/array.h"
 #include "la/vec.h"
+#include "la/eigen.h"
 #include "deprecated.h"
 #include "util/io.h"
 namespace cathal
@@ -87,6 +93,209 @@ class arnoldi
         return Val;
     }
 };
+
+/*
+    Symmetric Lanczos. Only the tridiagonal (Alpha on the diagonal, Beta beside it) and the last Keep basis
+    vectors are stored, so the memory is O(Keep N) rather than the O(Dim N) of arnoldi. Ritz vectors come from a
+    second pass that repeats the recurrence and accumulates the wanted combinations on the fly. Keep > 2 locally
+    reorthogonalises every new vector against the last Keep, which delays the loss of orthogonality (Keep > Dim
+    is full reorthogonalisation). Whatever orthogonality is lost shows up as extra copies of converged
+    eigenvalues and as spurious ones, both are filtered out after Cullum and Willoughby. U may be complex for a
+    Hermitian H, the tridiagonal is real either way.
+*/
+template<class T, class U = T>
+class lanczos
+{
+    private :
+    size_t Dim, Keep;
+    T Residual = 0.0;
+    std::vector<T> Alpha, Beta; //Beta[j] couples q_j and q_j+1.
+    vec<U> Start;
+
+    //Runs the recurrence from Start, Visit(j, q_j) sees every basis vector. Stops early on an invariant subspace.
+    T Recurrence(sqrarray<T, U> & H, std::function<void(size_t, vec<U> &)> Visit)
+    {
+        size_t R = std::max(Keep, size_t(2)) + 1; //The held vectors and the new one.
+        std::vector<vec<U> > Q(R);
+        for (auto & q : Q)
+            q.Resize(H.Index());
+        Q[0] = slice<U>(Start);
+        Normalise(Q[0]);
+        size_t Sz = Q[0].Size();
+
+        Alpha.clear();
+        Beta.clear();
+        T Norm = 0.0, Eps = std::numeric_limits<T>::epsilon();
+        for (size_t j = 0; j < Dim; j++)
+        {
+            vec<U> & P = Q[j % R];
+            vec<U> & C = Q[(j+1) % R];
+            Visit(j, P);
+            C = slice<U>(H * P);
+            T a = std::real(Dot(P, C));
+            Alpha.push_back(a);
+            for (size_t i = 0; i < Sz; i++)
+                C(i) -= a * P(i);
+            if (j > 0)
+            {
+                vec<U> & Prev = Q[(j-1) % R];
+                for (size_t i = 0; i < Sz; i++)
+                    C(i) -= Beta[j-1] * Prev(i);
+            }
+            //Local reorthogonalisation against every vector still held, C sits in the slot of the oldest.
+            for (size_t r = 0; Keep > 2 && r + 1 < R && r <= j; r++)
+            {
+                vec<U> & Old = Q[(j+R-r) % R];
+                U c = Dot(Old, C);
+                for (size_t i = 0; i < Sz; i++)
+                    C(i) -= c * Old(i);
+            }
+            Norm = std::max(Norm, std::abs(a) + (j > 0 ? Beta[j-1] : T(0)));
+            T b = std::real(Normalise(C));
+            if (j+1 == Dim || b <= Eps * Norm)
+            {
+                Residual = b;
+                break;
+            }
+            Beta.push_back(b);
+        }
+        return Residual;
+    }
+    //Eigenvalues of the tridiagonal, with Y the chosen rows of its eigenvectors (none, the last, or all).
+    std::vector<T> Tridiagonal(size_t First, fullblock<T> & Y, bool All)
+    {
+        size_t m = Alpha.size() - First;
+        std::vector<T> d(Alpha.begin() + First, Alpha.end()), e(m, T(0));
+        for (size_t i = 1; i < m; i++)
+            e[i] = Beta[First + i - 1];
+        Y.Resize((All ? m : 1), m);
+        std::fill(&Y(0), &Y(0) + Y.NumElem(), T(0));
+        for (size_t i = 0; i < m; i++)
+            if (All)
+                Y(i, i) = T(1);
+        if (!All)
+            Y(0, m-1) = T(1);
+        TridiagonalQL(d, e, Y);
+        return d;
+    }
+    //Indices of the good Ritz values of the tridiagonal (one per cluster of copies, spurious ones dropped).
+    std::vector<size_t> Good(std::vector<T> & Theta, fullblock<T> & Y)
+    {
+        std::vector<size_t> Index;
+        size_t m = Theta.size();
+        if (m == 0)
+            return Index;
+        T Norm = std::max(std::abs(Theta.front()), std::abs(Theta.back()));
+        T Tol = T(1e3) * std::numeric_limits<T>::epsilon() * Norm;
+
+        //A simple eigenvalue of T that is also one of T with its first row and column removed is spurious.
+        fullblock<T> None(0, 0);
+        std::vector<T> Hat = (m > 1 ? Tridiagonal(1, None, false) : std::vector<T>());
+        for (size_t i = 0; i < m; )
+        {
+            size_t Last = i;
+            while (Last+1 < m && Theta[Last+1] - Theta[i] <= Tol)
+                Last++;
+            //Of a cluster of copies keep the best converged, |Beta y_last| is its residual.
+            size_t Best = i;
+            for (size_t c = i; c <= Last; c++)
+                if (std::abs(Y(Y.Row()-1, c)) < std::abs(Y(Y.Row()-1, Best)))
+                    Best = c;
+            bool Spurious = false;
+            if (Last == i)
+            {
+                auto It = std::lower_bound(Hat.begin(), Hat.end(), Theta[i] - Tol);
+                Spurious = (It != Hat.end() && *It <= Theta[i] + Tol);
+            }
+            if (!Spurious)
+                Index.push_back(Best);
+            i = Last+1;
+        }
+        return Index;
+    }
+
+    public :
+    lanczos(sqrarray<T, U> & H, size_t N, size_t Keep = 2, bool Def = false) : Dim(N), Keep(Keep)
+    {
+        Start.Resize(H.Index());
+        Start.Set(1.0);
+        if (!Def)
+            Krylov(H);
+    }
+    //Start vector for the next Krylov call (normalised there).
+    void SetStart(vec<U> & In)
+    {
+        Start.Resize(In.Index());
+        Start = slice<U>(In);
+    }
+    T Krylov(sqrarray<T, U> & H)
+    {
+        return Recurrence(H, [](size_t, vec<U> &) {});
+    }
+    //Dimension actually reached, less than asked for if an invariant subspace turned up.
+    size_t Size()
+    {
+        return Alpha.size();
+    }
+    std::vector<T> & Diagonal()
+    {
+        return Alpha;
+    }
+    std::vector<T> & OffDiagonal()
+    {
+        return Beta;
+    }
+    //The distinct, non-spurious Ritz values in ascending order.
+    std::vector<T> Eigenvalues()
+    {
+        fullblock<T> Y(0, 0);
+        std::vector<T> Theta = Tridiagonal(0, Y, false);
+        std::vector<T> Values;
+        for (size_t i : Good(Theta, Y))
+            Values.push_back(Theta[i]);
+        return Values;
+    }
+    //An interval holding the extreme eigenvalues, the extreme Ritz values widened by their residuals.
+    std::pair<T, T> Bounds()
+    {
+        fullblock<T> Y(0, 0);
+        std::vector<T> Theta = Tridiagonal(0, Y, false);
+        size_t m = Theta.size();
+        if (m == 0)
+            throw(DIM_MISMATCH);
+        return std::make_pair(Theta.front() - Residual * std::abs(Y(0, 0)), Theta.back() + Residual * std::abs(Y(0, m-1)));
+    }
+    //Lowest Num good Ritz pairs, the vectors (as the columns of X) come from a second pass over H.
+    std::vector<T> Eigenvectors(sqrarray<T, U> & H, size_t Num, fullblock<U> & X)
+    {
+        fullblock<T> Y(0, 0);
+        std::vector<T> Theta = Tridiagonal(0, Y, true);
+        std::vector<size_t> Index = Good(Theta, Y);
+        Index.resize(std::min(Num, Index.size()));
+        std::vector<T> Values;
+        for (size_t i : Index)
+            Values.push_back(Theta[i]);
+
+        size_t m = Alpha.size(), Sz = Start.Size();
+        std::vector<T> KeepAlpha = Alpha, KeepBeta = Beta;
+        T KeepResidual = Residual;
+        X.Resize(Sz, Index.size());
+        std::fill(&X(0), &X(0) + X.NumElem(), U(0));
+        size_t Cols = Index.size();
+        Recurrence(H, [&](size_t j, vec<U> & q)
+        {
+            if (j >= m)
+                return;
+            for (size_t i = 0; i < Sz; i++)
+                for (size_t c = 0; c < Cols; c++)
+                    X(i, c) += Y(j, Index[c]) * q(i);
+        });
+        Alpha = KeepAlpha;
+        Beta = KeepBeta;
+        Residual = KeepResidual;
+        return Values;
+    }
+};
 }
 }
-#endif
\ No newline at end of file
+#endif
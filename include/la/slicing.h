@@ -0,0 +1,315 @@
+/* Cathal O Broin - cathal.obroin4 at mail.dcu.ie - 2015
+   This work is not developed in affiliation with any organisation.
+
+   This file is part of AILM.
+
+   AILM is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   AILM is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with AILM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CATHAL_LA_SLICING_GUARD
+#define CATHAL_LA_SLICING_GUARD
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include "util/error.h"
+#include "la/array.h"
+#include "la/factor.h"
+#include "la/eigen.h"
+namespace cathal
+{
+namespace la
+{
+/* ***************************************************
+ *
+ *          Spectrum Slicing
+ *      -Sturm counts, shift-invert Lanczos-
+ * ***************************************************/
+/*
+    H C = S C E for eigenvalues in [Lo, Hi) only. The number of eigenvalues below sigma is the number of
+    negative pivots of H - sigma S = L D L^T (Sylvester's law of inertia), so the range is cut into windows
+    holding about the same number of states and every window is solved on its own with shift-invert Lanczos,
+    (H - sigma S)^-1 S, about its midpoint. The eigenvalues nearest the shift come out first and the exact count
+    tells Lanczos when to stop, so no state outside the range is ever computed.
+*/
+template <class T>
+class slicing
+{
+    band<T> & H;
+    band<T> & S;
+    T Tol;
+    int N, k;
+
+    //y = A x over the band.
+    void Multiply(band<T> & A, const T * x, T * y)
+    {
+        const T * a = &A(0);
+        for (int i = 0; i < N; i++)
+        {
+            T Sum = T(0);
+            for (int j = std::max(0, i-k+1); j < std::min(N, i+k); j++)
+                Sum += a[(i*2+1)*(k-1) + j] * x[j];
+            y[i] = Sum;
+        }
+    }
+    //H - Sigma S, nudged off an eigenvalue if it lands on one.
+    ldlt<T> * Shifted(T & Sigma, T Nudge)
+    {
+        band<T> K(N, k);
+        for (int Try = 0; ; Try++)
+        {
+            for (size_t i = 0; i < K.NumElem(); i++)
+                K(i) = H(i) - Sigma * S(i);
+            try
+            {
+                return new ldlt<T>(K);
+            }
+            catch (ErrorCode)
+            {
+                if (Try == 8)
+                    throw(SINGULAR);
+                Sigma += Nudge;
+            }
+        }
+    }
+    //All the eigenpairs in [Lo, Hi), Count of them.
+    std::vector<T> Window(T Lo, T Hi, size_t Count, int Seed, std::vector<std::vector<T> > & X)
+    {
+        X.clear();
+        if (Count == 0)
+            return std::vector<T>();
+        T Sigma = (Lo + Hi) / T(2);
+        std::unique_ptr<ldlt<T> > K(Shifted(Sigma, (Hi - Lo) * T(1e-6)));
+
+        std::vector<std::vector<T> > Q, SQ;
+        std::vector<T> Alpha, Beta; //Beta[j] couples j-1 and j, Beta[0] is unused.
+        std::vector<T> W(N), SW(N);
+        T Eps = std::numeric_limits<T>::epsilon();
+        std::vector<T> Theta;
+        fullblock<T> Y(0, 0);
+
+        //S-normalises W against the current basis, returns its norm before normalisation.
+        auto Orthogonalise = [&]()
+        {
+            for (int Pass = 0; Pass < 2; Pass++)
+                for (size_t i = 0; i < Q.size(); i++)
+                {
+                    T c = T(0);
+                    for (int r = 0; r < N; r++)
+                        c += SQ[i][r] * W[r];
+                    for (int r = 0; r < N; r++)
+                        W[r] -= c * Q[i][r];
+                }
+            Multiply(S, W.data(), SW.data());
+            T Norm = T(0);
+            for (int r = 0; r < N; r++)
+                Norm += W[r] * SW[r];
+            return std::sqrt(std::max(Norm, T(0)));
+        };
+        auto Start = [&](int Restart)
+        {
+            for (int r = 0; r < N; r++)
+                W[r] = std::sin(T(0.7) * (r+1) * (Seed+1) + T(1.3) * (Restart+1)) + T(0.5);
+            return Orthogonalise();
+        };
+
+        T Norm = Start(0);
+        int Restarts = 0;
+        std::vector<T> E;
+        while (true)
+        {
+            for (int r = 0; r < N; r++)
+            {
+                W[r] /= Norm;
+                SW[r] /= Norm;
+            }
+            Q.push_back(W);
+            SQ.push_back(SW);
+            size_t j = Q.size() - 1;
+
+            //W = (H - Sigma S)^-1 S q_j
+            W = SW;
+            K->Solve(W.data(), 1);
+            T a = T(0);
+            for (int r = 0; r < N; r++)
+                a += SQ[j][r] * W[r];
+            Alpha.push_back(a);
+            Norm = Orthogonalise();
+
+            //A breakdown means an invariant subspace, start again orthogonal to it (picks up degenerate states).
+            bool Breakdown = (Norm <= Eps * std::max(std::abs(a), T(1)) * T(N));
+            if (Breakdown && Q.size() < size_t(N))
+            {
+                Norm = Start(++Restarts);
+                Beta.push_back(T(0));
+            }
+            else
+                Beta.push_back(Norm);
+
+            bool Last = (Q.size() == size_t(N));
+            if (Q.size() < Count || (!Last && !Breakdown && (Q.size() - Count) % 5 != 0))
+                continue;
+
+            size_t m = Q.size();
+            Theta = Alpha;
+            std::vector<T> e(m, T(0));
+            for (size_t i = 1; i < m; i++)
+                e[i] = Beta[i-1];
+            Y.Resize(m, m);
+            std::fill(&Y(0), &Y(0) + m*m, T(0));
+            for (size_t i = 0; i < m; i++)
+                Y(i, i) = T(1);
+            TridiagonalQL(Theta, e, Y);
+
+            E.clear();
+            std::vector<size_t> Keep;
+            for (size_t i = 0; i < m; i++)
+            {
+                if (Theta[i] == T(0))
+                    continue;
+                T Lambda = Sigma + T(1) / Theta[i];
+                bool Converged = Last || std::abs(Beta[m-1] * Y(m-1, i)) <= Tol * std::abs(Theta[i]);
+                if (Converged && Lambda >= Lo && Lambda < Hi)
+                    Keep.push_back(i);
+            }
+            if (Keep.size() < Count && !Last)
+                continue;
+            if (Keep.size() != Count)
+                throw(NOT_CONVERGED);
+
+            //Ritz vectors X = Q y, ascending in lambda.
+            std::sort(Keep.begin(), Keep.end(), [&Theta, Sigma](size_t a, size_t b) { return Sigma + T(1) / Theta[a] < Sigma + T(1) / Theta[b]; });
+            X.assign(Count, std::vector<T>(N, T(0)));
+            for (size_t c = 0; c < Count; c++)
+            {
+                E.push_back(Sigma + T(1) / Theta[Keep[c]]);
+                for (size_t i = 0; i < m; i++)
+                {
+                    T yi = Y(i, Keep[c]);
+                    for (int r = 0; r < N; r++)
+                        X[c][r] += yi * Q[i][r];
+                }
+            }
+            return E;
+        }
+    }
+
+    public :
+    //Tol is the relative residual of the shift-inverted Ritz pairs.
+    slicing(band<T> & H, band<T> & S, T Tol = T(1e-10)) : H(H), S(S), Tol(Tol), N(H.Row()), k(H.Order())
+    {
+        if (S.Row() != H.Row() || S.Order() != H.Order())
+            throw(SIZE_MISMATCH);
+    }
+    //Number of eigenvalues below Sigma.
+    size_t Count(T Sigma)
+    {
+        std::unique_ptr<ldlt<T> > K(Shifted(Sigma, std::max(std::abs(Sigma), T(1)) * T(1e-12)));
+        return K->Inertia();
+    }
+    //Window edges from Lo to Hi with about the same number of eigenvalues between each pair.
+    std::vector<T> Split(T Lo, T Hi, size_t Windows)
+    {
+        size_t CLo = Count(Lo), CHi = Count(Hi);
+        Windows = std::max(size_t(1), std::min(Windows, CHi - CLo));
+        std::vector<T> Edge(1, Lo);
+        for (size_t w = 1; w < Windows; w++)
+        {
+            size_t Target = CLo + (w * (CHi - CLo)) / Windows;
+            T a = Edge.back(), b = Hi;
+            for (int It = 0; It < 60; It++)
+            {
+                T Mid = (a + b) / T(2);
+                size_t C = Count(Mid);
+                if (C == Target)
+                {
+                    a = b = Mid;
+                    break;
+                }
+                (C < Target ? a : b) = Mid;
+            }
+            Edge.push_back((a + b) / T(2));
+        }
+        Edge.push_back(Hi);
+        return Edge;
+    }
+    //Eigenpairs in [Lo, Hi) in ascending order, C gets the S-orthonormal eigenvectors as columns.
+    std::vector<T> Solve(T Lo, T Hi, fullblock<T> & C, size_t Windows)
+    {
+        std::vector<T> Edge = Split(Lo, Hi, Windows);
+        int NumWin = Edge.size() - 1;
+        std::vector<size_t> Counts(NumWin + 1);
+        for (int w = 0; w <= NumWin; w++)
+            Counts[w] = Count(Edge[w]);
+
+        std::vector<std::vector<T> > E(NumWin);
+        std::vector<std::vector<std::vector<T> > > X(NumWin);
+#pragma omp parallel for shared(Edge, Counts, E, X) firstprivate(NumWin) default(none) schedule(dynamic, 1)
+        for (int w = 0; w < NumWin; w++)
+            E[w] = Window(Edge[w], Edge[w+1], Counts[w+1] - Counts[w], w, X[w]);
+
+        std::vector<T> All;
+        for (int w = 0; w < NumWin; w++)
+            All.insert(All.end(), E[w].begin(), E[w].end());
+        C.Resize(N, All.size());
+        size_t Col = 0;
+        for (int w = 0; w < NumWin; w++)
+            for (auto & x : X[w])
+            {
+                for (int r = 0; r < N; r++)
+                    C(r, Col) = x[r];
+                Col++;
+            }
+        return All;
+    }
+    //The lowest Num eigenpairs.
+    std::vector<T> Lowest(size_t Num, fullblock<T> & C, size_t Windows)
+    {
+        Num = std::min(Num, size_t(N));
+        T Lo = T(-1), Hi = T(1);
+        for (int It = 0; Count(Lo) > 0; It++, Lo *= T(2))
+            if (It == 200)
+                throw(NOT_CONVERGED);
+        for (int It = 0; Count(Hi) < Num; It++, Hi *= T(2))
+            if (It == 200)
+                throw(NOT_CONVERGED);
+        //Pull Hi down into the gap above the Num-th eigenvalue.
+        T a = Lo, b = Hi;
+        for (int It = 0; It < 60; It++)
+        {
+            T Mid = (a + b) / T(2);
+            size_t Cnt = Count(Mid);
+            if (Cnt == Num)
+            {
+                b = Mid;
+                break;
+            }
+            (Cnt < Num ? a : b) = Mid;
+        }
+        std::vector<T> E = Solve(Lo, b, C, Windows);
+        if (E.size() > Num)
+        {
+            E.resize(Num);
+            fullblock<T> D(N, Num);
+            for (int r = 0; r < N; r++)
+                for (size_t c = 0; c < Num; c++)
+                    D(r, c) = C(r, c);
+            C = D;
+        }
+        return E;
+    }
+};
+}
+}
+#endif
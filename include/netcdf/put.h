@@ -0,0 +1,87 @@
+/* Cathal O Broin - cathal.obroin4 at mail.dcu.ie - 2015
+   This work is not developed in affiliation with any organisation.
+
+   This file is part of AILM.
+
+   AILM is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   AILM is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with AILM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+* SPECIAL NOTE:
+* Requires netcdf-cxx package (archlinux) or equivalent. Uses the (Appel) NetCDF API.
+* Writers to match get.h, the NetCDF library isn't thread safe so every call holds the netcdf critical section.
+*/
+#ifndef NETCDF_PUT_GUARD
+#define NETCDF_PUT_GUARD
+#include <ncFile.h>
+#include <ncVar.h>
+#include <ncDim.h>
+#include <vector>
+#include <string>
+#include "la/array.h"
+
+namespace cathal
+{
+namespace nc
+{
+template <class T>
+netCDF::NcType Type();
+template <>
+inline netCDF::NcType Type<double>()
+{
+    return netCDF::ncDouble;
+}
+template <>
+inline netCDF::NcType Type<int>()
+{
+    return netCDF::ncInt;
+}
+
+//Creates (or empties) the file, the Put functions then add one variable each.
+inline void Create(const std::string & FileName)
+{
+#pragma omp critical(netcdf)
+    {
+        netCDF::NcFile File(FileName, netCDF::NcFile::replace);
+    }
+}
+
+template <class T>
+void PutVector(const std::string & FileName, const std::string & Name, std::vector<T> & Data)
+{
+#pragma omp critical(netcdf)
+    {
+        netCDF::NcFile File(FileName, netCDF::NcFile::write);
+
+        netCDF::NcDim Dim = File.addDim(Name + "Dim", Data.size());
+        netCDF::NcVar Var = File.addVar(Name, Type<T>(), Dim);
+        Var.putVar(Data.data());
+    }
+}
+
+template <class T>
+void PutBlock(const std::string & FileName, const std::string & Name, la::fullblock<T> & Data)
+{
+#pragma omp critical(netcdf)
+    {
+        netCDF::NcFile File(FileName, netCDF::NcFile::write);
+
+        std::vector<netCDF::NcDim> Dim = {File.addDim(Name + "Row", Data.Row()), File.addDim(Name + "Column", Data.Column())};
+        netCDF::NcVar Var = File.addVar(Name, Type<T>(), Dim);
+        Var.putVar(&Data(0));
+    }
+}
+
+}
+}
+#endif
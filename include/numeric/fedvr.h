@@ -0,0 +1,176 @@
+/* Cathal O Broin - cathal.obroin4 at mail.dcu.ie - 2015
+   This work is not developed in affiliation with any organisation.
+
+   This file is part of AILM.
+
+   AILM is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   AILM is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with AILM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CATHAL_FEDVR_GUARD
+#define CATHAL_FEDVR_GUARD
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "numeric/type.h"
+#include "util/error.h"
+#include "numeric/integrate.h"
+#include "numeric/splines.h"
+#include "la/array.h"
+
+namespace cathal
+{
+namespace dvr
+{
+/*
+    Finite element DVR: every knot interval of non-zero length is an element with N Gauss-Lobatto points, the
+    Lagrange interpolants f_i on those points are the basis and the end points are shared by neighbouring
+    elements (bridge functions). With Lobatto quadrature the overlap and any local potential are diagonal,
+    <f_i|f_j> = w_i delta_ij, and the kinetic energy couples points of the same element, a band with k = N.
+    As with Shrink the first IgnoreStart and last IgnoreEnd points are dropped (psi(0) = psi(R) = 0).
+*/
+template <class T=real>
+class fedvr
+{
+    size_t n, Ne, Start, Size_;
+    std::vector<T> Xg, Wg;  //All of the points and weights, before trimming.
+    std::vector<T> Scale;   //2/(b-a) of each element.
+    std::vector<T> Wr, D;   //Reference weights and D[q*n + m] = f_m'(x_q) on [-1, 1].
+
+    public :
+    fedvr(std::vector<T> & Knots, size_t N, size_t IgnoreStart = 1, size_t IgnoreEnd = 1) : n(N), Ne(0), Start(IgnoreStart)
+    {
+        if (N < 2)
+            throw(OUT_OF_BOUNDS);
+        quadrature::gauss<T, T> Lobatto(N, quadrature::LOBATTO);
+        std::vector<T> Xr;
+        Lobatto.Map(T(-1), T(1), Xr, Wr);
+
+        //Barycentric weights give the derivatives of the interpolants at the nodes.
+        std::vector<T> Bary(n, T(1));
+        for (size_t m = 0; m < n; m++)
+            for (size_t j = 0; j < n; j++)
+                if (j != m)
+                    Bary[m] /= (Xr[m] - Xr[j]);
+        D.assign(n*n, T(0));
+        for (size_t q = 0; q < n; q++)
+        {
+            T Diag = T(0);
+            for (size_t m = 0; m < n; m++)
+                if (m != q)
+                {
+                    D[q*n + m] = Bary[m] / Bary[q] / (Xr[q] - Xr[m]);
+                    Diag -= D[q*n + m];
+                }
+            D[q*n + q] = Diag;
+        }
+
+        std::vector<T> X, W;
+        for (size_t s = 0; s+1 < Knots.size(); s++)
+        {
+            if (Knots[s] == Knots[s+1])
+                continue;
+            Lobatto.Map(Knots[s], Knots[s+1], X, W);
+            if (Ne == 0)
+            {
+                Xg.push_back(X[0]);
+                Wg.push_back(T(0));
+            }
+            Wg.back() += W[0];
+            Xg.insert(Xg.end(), X.begin() + 1, X.end());
+            Wg.insert(Wg.end(), W.begin() + 1, W.end());
+            Scale.push_back(T(2) / (Knots[s+1] - Knots[s]));
+            Ne++;
+        }
+        if (Ne == 0 || Xg.size() < IgnoreStart + IgnoreEnd)
+            throw(OUT_OF_BOUNDS);
+        Size_ = Xg.size() - IgnoreStart - IgnoreEnd;
+    }
+
+    size_t Order()
+    {
+        return n;
+    }
+    size_t Elements()
+    {
+        return Ne;
+    }
+    //Number of basis functions (after trimming).
+    size_t Size()
+    {
+        return Size_;
+    }
+    T X(size_t i)
+    {
+        return Xg[Start + i];
+    }
+    T W(size_t i)
+    {
+        return Wg[Start + i];
+    }
+
+    la::diag<T> Overlap()
+    {
+        std::vector<T> S(Wg.begin() + Start, Wg.begin() + Start + Size_);
+        return la::diag<T>(S, Size_);
+    }
+    //<f_i|V|f_j> = V(x_i) w_i delta_ij
+    la::diag<T> Potential(spline::QSOLFunc Fun)
+    {
+        std::vector<T> V(Size_);
+        for (size_t i = 0; i < Size_; i++)
+            V[i] = Fun(X(i)) * W(i);
+        return la::diag<T>(V, Size_);
+    }
+    //W^-1/2 (T + V) W^-1/2, the standard form. The overlap is W so nothing has to be solved with it, the
+    //eigenvectors are w^1/2 times the values at the points and the potential is just V(x_i) on the diagonal.
+    la::band<T> Standard(spline::QSOLFunc Fun)
+    {
+        la::band<T> H = Kinetic();
+        int N = Size_, k = n;
+        for (int i = 0; i < N; i++)
+        {
+            for (int j = std::max(0, i-k+1); j < std::min(N, i+k); j++)
+                H(i, j) /= std::sqrt(W(i) * W(j));
+            H(i, i) += Fun(X(i));
+        }
+        return H;
+    }
+    //<f_i'|f_j'>/2, the local matrices of neighbouring elements overlap on the bridge points.
+    la::band<T> Kinetic()
+    {
+        la::band<T> K(Size_, n);
+        int First = Start, Last = Start + Size_;
+        for (size_t e = 0; e < Ne; e++)
+        {
+            int Off = e*(n-1);
+            for (size_t a = 0; a < n; a++)
+            {
+                if (int(Off+a) < First || int(Off+a) >= Last)
+                    continue;
+                for (size_t b = 0; b < n; b++)
+                {
+                    if (int(Off+b) < First || int(Off+b) >= Last)
+                        continue;
+                    T Sum = T(0);
+                    for (size_t q = 0; q < n; q++)
+                        Sum += Wr[q] * D[q*n + a] * D[q*n + b];
+                    K(Off+a-First, Off+b-First) += T(0.5) * Sum * Scale[e];
+                }
+            }
+        }
+        return K;
+    }
+};
+}
+}
+#endif
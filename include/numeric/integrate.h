@@ -19,33 +19,273 @@
 #ifndef CATHAL_QUADRATURE_GUARD
 #define CATHAL_QUADRATURE_GUARD
 
-#include <gsl/gsl_integration.h>
+#include <array>
+#include <vector>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <type_traits>
 #include "numeric/type.h"
+#include "util/error.h"
 
 namespace cathal
 {
 namespace quadrature
 {
+    //Gauss-Legendre rules on [-1, 1] as compile time tables, for the orders the spline code uses (3 to 12).
+    template <size_t N>
+    struct legendre;
+    template <>
+    struct legendre<3>
+    {
+        static constexpr std::array<real, 3> Nodes()
+        {
+            return {{-0.7745966692414834, 0.0, 0.7745966692414834}};
+        }
+        static constexpr std::array<real, 3> Weights()
+        {
+            return {{0.5555555555555556, 0.8888888888888888, 0.5555555555555556}};
+        }
+    };
+    template <>
+    struct legendre<4>
+    {
+        static constexpr std::array<real, 4> Nodes()
+        {
+            return {{-0.8611363115940526, -0.33998104358485626, 0.33998104358485626, 0.8611363115940526}};
+        }
+        static constexpr std::array<real, 4> Weights()
+        {
+            return {{0.34785484513745385, 0.6521451548625461, 0.6521451548625461, 0.34785484513745385}};
+        }
+    };
+    template <>
+    struct legendre<5>
+    {
+        static constexpr std::array<real, 5> Nodes()
+        {
+            return {{-0.906179845938664, -0.5384693101056831, 0.0, 0.5384693101056831, 0.906179845938664}};
+        }
+        static constexpr std::array<real, 5> Weights()
+        {
+            return {{0.23692688505618908, 0.47862867049936647, 0.5688888888888889, 0.47862867049936647, 0.23692688505618908}};
+        }
+    };
+    template <>
+    struct legendre<6>
+    {
+        static constexpr std::array<real, 6> Nodes()
+        {
+            return {{-0.932469514203152, -0.6612093864662645, -0.2386191860831969, 0.2386191860831969, 0.6612093864662645, 0.932469514203152}};
+        }
+        static constexpr std::array<real, 6> Weights()
+        {
+            return {{0.17132449237917036, 0.3607615730481386, 0.46791393457269104, 0.46791393457269104, 0.3607615730481386, 0.17132449237917036}};
+        }
+    };
+    template <>
+    struct legendre<7>
+    {
+        static constexpr std::array<real, 7> Nodes()
+        {
+            return {{-0.9491079123427585, -0.7415311855993945, -0.4058451513773972, 0.0, 0.4058451513773972, 0.7415311855993945, 0.9491079123427585}};
+        }
+        static constexpr std::array<real, 7> Weights()
+        {
+            return {{0.1294849661688697, 0.27970539148927664, 0.3818300505051189, 0.4179591836734694, 0.3818300505051189, 0.27970539148927664, 0.1294849661688697}};
+        }
+    };
+    template <>
+    struct legendre<8>
+    {
+        static constexpr std::array<real, 8> Nodes()
+        {
+            return {{-0.9602898564975363, -0.7966664774136267, -0.525532409916329, -0.1834346424956498, 0.1834346424956498, 0.525532409916329, 0.7966664774136267, 0.9602898564975363}};
+        }
+        static constexpr std::array<real, 8> Weights()
+        {
+            return {{0.10122853629037626, 0.22238103445337448, 0.31370664587788727, 0.362683783378362, 0.362683783378362, 0.31370664587788727, 0.22238103445337448, 0.10122853629037626}};
+        }
+    };
+    template <>
+    struct legendre<9>
+    {
+        static constexpr std::array<real, 9> Nodes()
+        {
+            return {{-0.9681602395076261, -0.8360311073266358, -0.6133714327005904, -0.3242534234038089, 0.0, 0.3242534234038089, 0.6133714327005904, 0.8360311073266358, 0.9681602395076261}};
+        }
+        static constexpr std::array<real, 9> Weights()
+        {
+            return {{0.08127438836157441, 0.1806481606948574, 0.26061069640293544, 0.31234707704000286, 0.3302393550012598, 0.31234707704000286, 0.26061069640293544, 0.1806481606948574, 0.08127438836157441}};
+        }
+    };
+    template <>
+    struct legendre<10>
+    {
+        static constexpr std::array<real, 10> Nodes()
+        {
+            return {{-0.9739065285171717, -0.8650633666889845, -0.6794095682990244, -0.4333953941292472, -0.14887433898163122, 0.14887433898163122, 0.4333953941292472, 0.6794095682990244, 0.8650633666889845, 0.9739065285171717}};
+        }
+        static constexpr std::array<real, 10> Weights()
+        {
+            return {{0.06667134430868814, 0.1494513491505806, 0.21908636251598204, 0.26926671930999635, 0.29552422471475287, 0.29552422471475287, 0.26926671930999635, 0.21908636251598204, 0.1494513491505806, 0.06667134430868814}};
+        }
+    };
+    template <>
+    struct legendre<11>
+    {
+        static constexpr std::array<real, 11> Nodes()
+        {
+            return {{-0.978228658146057, -0.8870625997680953, -0.7301520055740494, -0.5190961292068118, -0.26954315595234496, 0.0, 0.26954315595234496, 0.5190961292068118, 0.7301520055740494, 0.8870625997680953, 0.978228658146057}};
+        }
+        static constexpr std::array<real, 11> Weights()
+        {
+            return {{0.05566856711617366, 0.1255803694649046, 0.18629021092773426, 0.23319376459199048, 0.26280454451024665, 0.2729250867779006, 0.26280454451024665, 0.23319376459199048, 0.18629021092773426, 0.1255803694649046, 0.05566856711617366}};
+        }
+    };
+    template <>
+    struct legendre<12>
+    {
+        static constexpr std::array<real, 12> Nodes()
+        {
+            return {{-0.9815606342467192, -0.9041172563704749, -0.7699026741943047, -0.5873179542866175, -0.3678314989981802, -0.1252334085114689, 0.1252334085114689, 0.3678314989981802, 0.5873179542866175, 0.7699026741943047, 0.9041172563704749, 0.9815606342467192}};
+        }
+        static constexpr std::array<real, 12> Weights()
+        {
+            return {{0.04717533638651183, 0.10693932599531843, 0.16007832854334622, 0.20316742672306592, 0.2334925365383548, 0.24914704581340277, 0.24914704581340277, 0.2334925365383548, 0.20316742672306592, 0.16007832854334622, 0.10693932599531843, 0.04717533638651183}};
+        }
+    };
+
+    //Quadrature with the order fixed at compile time, so the loop over the nodes can be unrolled.
+    template <size_t N, class T = real, class P = real, class F>
+    T FixedQuad(P a, P b, F && Cast)
+    {
+        constexpr std::array<real, N> Xi = legendre<N>::Nodes();
+        constexpr std::array<real, N> Wi = legendre<N>::Weights();
+        T Val = T(0);
+        for (size_t i = 0; i < N; i++)
+            Val += Wi[i] * Cast((b-a)/T(2) * Xi[i] + (b + a)/T(2));
+        Val *= (b-a)/T(2);
+        return Val;
+    }
+
+    //Node sets on [-1, 1] that are generated natively.
+    typedef enum
+    {
+        LEGENDRE,
+        LOBATTO
+    } RuleKind;
+
+    //Legendre polynomial P_n(x) and its derivative by the three term recurrence.
+    template <class T>
+    std::pair<T, T> LegendreP(size_t n, T x)
+    {
+        T P0 = T(1), P1 = x;
+        if (n == 0)
+            return std::make_pair(P0, T(0));
+        for (size_t j = 2; j <= n; j++)
+        {
+            T P2 = (T(2*j-1)*x*P1 - T(j-1)*P0) / T(j);
+            P0 = P1;
+            P1 = P2;
+        }
+        return std::make_pair(P1, T(n)*(x*P1 - P0)/(x*x - T(1)));
+    }
+
+    //Gauss-Legendre nodes (ascending) and weights by Newton iteration, in any floating type.
+    template <class T>
+    void LegendreRule(size_t N, std::vector<T> & X, std::vector<T> & W)
+    {
+        X.assign(N, T(0));
+        W.assign(N, T(0));
+        for (size_t i = 0; i < (N+1)/2; i++)
+        {
+            T x = std::cos(std::acos(T(-1)) * (T(i) + T(0.75)) / (T(N) + T(0.5)));
+            std::pair<T, T> P;
+            for (int It = 0; It < 100; It++)
+            {
+                P = LegendreP(N, x);
+                T dx = P.first / P.second;
+                x -= dx;
+                if (std::abs(dx) <= std::numeric_limits<T>::epsilon() * std::abs(x))
+                    break;
+            }
+            P = LegendreP(N, x);
+            if (2*i+1 == N)
+                x = T(0);
+            X[i] = -x;
+            X[N-1-i] = x;
+            W[i] = W[N-1-i] = T(2) / ((T(1) - x*x) * P.second*P.second);
+        }
+    }
+
+    //Gauss-Lobatto nodes (ascending, including the end points) and weights. The interior nodes are the roots of
+    //P'_{N-1}, found by Newton iteration with P'' taken from the Legendre equation.
+    template <class T>
+    void LobattoRule(size_t N, std::vector<T> & X, std::vector<T> & W)
+    {
+        if (N < 2)
+            throw(OUT_OF_BOUNDS);
+        size_t n = N-1;
+        X.assign(N, T(0));
+        W.assign(N, T(0));
+        for (size_t i = 0; i < (N+1)/2; i++)
+        {
+            T x = std::cos(std::acos(T(-1)) * T(i) / T(n));
+            if (i > 0 && 2*i != n)
+                for (int It = 0; It < 100; It++)
+                {
+                    std::pair<T, T> P = LegendreP(n, x);
+                    T DDP = (T(2)*x*P.second - T(n*(n+1))*P.first) / (T(1) - x*x);
+                    T dx = P.second / DDP;
+                    x -= dx;
+                    if (std::abs(dx) <= std::numeric_limits<T>::epsilon() * std::abs(x))
+                        break;
+                }
+            if (2*i == n)
+                x = T(0);
+            T Pn = LegendreP(n, x).first;
+            X[i] = -x;
+            X[N-1-i] = x;
+            W[i] = W[N-1-i] = T(2) / (T(n*(n+1)) * Pn*Pn);
+        }
+    }
+
+    //Process wide, thread safe cache of generated rules. There is one cache per type, keyed by order and kind.
+    //Rules are never removed, so the returned reference stays valid.
+    template <class T>
+    const std::pair<std::vector<T>, std::vector<T> > & Rule(size_t N, RuleKind Kind = LEGENDRE)
+    {
+        static std::mutex Lock;
+        static std::map<std::pair<size_t, int>, std::pair<std::vector<T>, std::vector<T> > > Cache;
+
+        std::lock_guard<std::mutex> Guard(Lock);
+        auto Key = std::make_pair(N, int(Kind));
+        auto it = Cache.find(Key);
+        if (it == Cache.end())
+        {
+            std::pair<std::vector<T>, std::vector<T> > New;
+            if (Kind == LEGENDRE)
+                LegendreRule(N, New.first, New.second);
+            else
+                LobattoRule(N, New.first, New.second);
+            it = Cache.emplace(Key, New).first;
+        }
+        return it->second;
+    }
+
     template <class T=real, class P=real>
     class gauss
     {
         private :
         size_t n;
-        //Type is baked in. No choice since the GSL library doesn't provide choice.
-        std::vector<double> Xi, Wi;
+        bool Legendre = false; //Standard double rule, so the fixed order tables can be used.
+        std::vector<P> Xi, Wi;
 
-        void GSLTable(size_t N)
-        {
-            n = N;
-            gsl_integration_glfixed_table * GLTable = gsl_integration_glfixed_table_alloc(n);
-            Xi.resize(n);
-            Wi.resize(n);
-
-            for (size_t i = 0; i < GLTable->n; i++)
-                gsl_integration_glfixed_point(-1.0, 1.0, i, &Xi[i], &Wi[i], GLTable);
-            gsl_integration_glfixed_table_free(GLTable);
-        }
-        
         public :
 
         gauss(std::vector<std::pair<P, P>> Val) : n(Val.size()), Xi(Val.size()), Wi(Val.size())
@@ -57,22 +297,65 @@ namespace quadrature
             }
         }
 
-        gauss(size_t N)
+        gauss(size_t N, RuleKind Kind = LEGENDRE) : n(N)
         {
-            GSLTable(N);
+            const std::pair<std::vector<P>, std::vector<P> > & Nodes = Rule<P>(N, Kind);
+            Xi = Nodes.first;
+            Wi = Nodes.second;
+            Legendre = (Kind == LEGENDRE && std::is_same<P, real>::value);
         }
 
-        T Quad(P a, P b, std::function<T(P)> Cast)
+        size_t Order()
         {
+            return n;
+        }
+
+        //The nodes and weights mapped onto [a, b], the weights include the (b-a)/2 factor.
+        void Map(P a, P b, std::vector<P> & X, std::vector<T> & W)
+        {
+            X.resize(n);
+            W.resize(n);
+            for (size_t i = 0; i < n; i++)
+            {
+                X[i] = (b-a)/T(2) * Xi[i] + (b + a)/T(2);
+                W[i] = (b-a)/T(2) * Wi[i];
+            }
+        }
+
+        //Callables are taken as a template parameter so they can be inlined, the std::function
+        //overloads below are thin wrappers kept for type-erased callers.
+        template <class F>
+        T Quad(P a, P b, F && Cast)
+        {
+            if (Legendre)
+                switch (n)
+                {
+                    case 3 : return FixedQuad<3, T>(a, b, Cast);
+                    case 4 : return FixedQuad<4, T>(a, b, Cast);
+                    case 5 : return FixedQuad<5, T>(a, b, Cast);
+                    case 6 : return FixedQuad<6, T>(a, b, Cast);
+                    case 7 : return FixedQuad<7, T>(a, b, Cast);
+                    case 8 : return FixedQuad<8, T>(a, b, Cast);
+                    case 9 : return FixedQuad<9, T>(a, b, Cast);
+                    case 10 : return FixedQuad<10, T>(a, b, Cast);
+                    case 11 : return FixedQuad<11, T>(a, b, Cast);
+                    case 12 : return FixedQuad<12, T>(a, b, Cast);
+                }
+
             T Val = T(0);
             for (size_t i = 0; i < n; i++)
                 Val += Wi[i] * Cast((b-a)/T(2) * Xi[i] + (b + a)/T(2));
             Val *= (b-a)/T(2);
             return Val;
         }
-        
+        T Quad(P a, P b, std::function<T(P)> Cast)
+        {
+            return Quad<std::function<T(P)> &>(a, b, Cast);
+        }
+
         //Recursive calculation.
-        T Recursive(T Tol, T Compare, P a, P b, std::function<T(P)> Cast)
+        template <class F>
+        T Recursive(T Tol, T Compare, P a, P b, F && Cast)
         {
             T Val1 = Quad(a, a + (b-a)/P(2), Cast);
             T Val2 = Quad(a + (b-a)/P(2), b, Cast);
@@ -87,14 +370,293 @@ namespace quadrature
             else
                 return Val1+Val2;
         }
-        T Adaptive(T Tol, P a, P b, std::function<T(P)> Cast)
+        template <class F>
+        T Adaptive(T Tol, P a, P b, F && Cast)
         {
             T Test = Quad(a, b, Cast);
             return Recursive(Tol, Test, a, b, Cast);
         }
+        T Adaptive(T Tol, P a, P b, std::function<T(P)> Cast)
+        {
+            return Adaptive<std::function<T(P)> &>(Tol, a, b, Cast);
+        }
+    };
+    //Result of an adaptive integration, along with its error estimate and the number of integrand calls.
+    template <class T=real, class P=real>
+    struct estimate
+    {
+        T Value;
+        P Error;
+        size_t Evaluations;
+        bool Converged;
+    };
+
+    //Gauss-Kronrod 7-15 pair, the abscissae and weights from QUADPACK (qk15). The odd Kronrod nodes are the
+    //Gauss nodes, so the embedded 7 point estimate reuses function values rather than costing any more calls.
+    struct kronrod15
+    {
+        static constexpr std::array<real, 8> Nodes()
+        {
+            return {{0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+                     0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+                     0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+                     0.207784955007898467600689403773245, 0.0}};
+        }
+        static constexpr std::array<real, 8> Weights()
+        {
+            return {{0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+                     0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+                     0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+                     0.204432940075298892414161999234649, 0.209482141084727828012999174891714}};
+        }
+        static constexpr std::array<real, 4> Gauss()
+        {
+            return {{0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+                     0.381830050505118944950369775488975, 0.417959183673469387755102040816327}};
+        }
+    };
+
+    //Globally adaptive Gauss-Kronrod integration. The interval with the largest error estimate is always
+    //the one bisected, until the summed error is inside the budget or the evaluation limit is reached.
+    template <class T=real, class P=real>
+    class kronrod
+    {
+        private :
+        struct segment
+        {
+            P a, b;
+            T Val;
+            P Err, Floor; //Floor is the rounding level of the panel, 50 eps int |f|.
+            bool operator<(const segment & Other) const
+            {
+                return Err < Other.Err;
+            }
+        };
+        P AbsTol, RelTol;
+        size_t MaxEval;
+        size_t MaxDepth;
+
+        //Bisection with a local acceptance test, so whether an interval is split doesn't depend on the others.
+        //S has been evaluated already. It passes if Err <= Density*(b-a), or if Err is down at the rounding floor
+        //of the panel (which grows with (b-a) just as the allowance does, so for large |f| no bisection can ever
+        //get under the allowance alone). Budget is the number of evaluations this interval may still spend,
+        //halved between the two children, so the total never depends on the scheduling. The halves are tasks
+        //and are summed in a fixed order after the taskwait.
+        template <class F>
+        estimate<T, P> Refine(segment S, P Density, size_t Depth, size_t Budget, F * Cast)
+        {
+            estimate<T, P> Res = {S.Val, S.Err, 0, true};
+            if (S.Err <= std::max(Density * (S.b - S.a), S.Floor))
+                return Res;
+            P a = S.a, b = S.b;
+            P Mid = a + (b-a)/P(2);
+            if (Depth == 0 || Budget < 30 || Mid == a || Mid == b)
+            {
+                Res.Converged = false;
+                return Res;
+            }
+
+            estimate<T, P> L, R;
+            size_t Rest = (Budget - 30) / 2;
+            #pragma omp task shared(L) firstprivate(a, Mid, Density, Depth, Rest, Cast) default(none)
+            L = Refine(Panel(a, Mid, *Cast), Density, Depth-1, Rest, Cast);
+            #pragma omp task shared(R) firstprivate(b, Mid, Density, Depth, Rest, Cast) default(none)
+            R = Refine(Panel(Mid, b, *Cast), Density, Depth-1, Rest, Cast);
+            #pragma omp taskwait
+
+            Res.Value = L.Value + R.Value;
+            Res.Error = L.Error + R.Error;
+            Res.Evaluations = 30 + L.Evaluations + R.Evaluations;
+            Res.Converged = L.Converged && R.Converged;
+            return Res;
+        }
+
+        public :
+
+        kronrod(P AbsTol = 1e-12, P RelTol = 1e-10, size_t MaxEval = 50000, size_t MaxDepth = 40)
+            : AbsTol(AbsTol), RelTol(RelTol), MaxEval(MaxEval), MaxDepth(MaxDepth)
+        {
+        }
+
+        P Tolerance(T Val)
+        {
+            return std::max(AbsTol, RelTol * std::abs(Val));
+        }
+
+        //A single 15 point panel on [a, b], with the QUADPACK error scaling.
+        template <class F>
+        segment Panel(P a, P b, F && Cast)
+        {
+            const std::array<real, 8> X = kronrod15::Nodes();
+            const std::array<real, 8> WK = kronrod15::Weights();
+            const std::array<real, 4> WG = kronrod15::Gauss();
+            P Half = (b-a)/P(2);
+            P Centre = (b+a)/P(2);
+
+            T FV[15];
+            FV[7] = Cast(Centre);
+            for (size_t i = 0; i < 7; i++)
+            {
+                FV[i] = Cast(Centre - Half * X[i]);
+                FV[14-i] = Cast(Centre + Half * X[i]);
+            }
+
+            T K = WK[7] * FV[7];
+            T G = WG[3] * FV[7];
+            P Abs = WK[7] * std::abs(FV[7]);
+            for (size_t i = 0; i < 7; i++)
+            {
+                K += WK[i] * (FV[i] + FV[14-i]);
+                Abs += WK[i] * (std::abs(FV[i]) + std::abs(FV[14-i]));
+                if (i % 2 == 1)
+                    G += WG[i/2] * (FV[i] + FV[14-i]);
+            }
+            T Mean = K / T(2);
+            P Asc = WK[7] * std::abs(FV[7] - Mean);
+            for (size_t i = 0; i < 7; i++)
+                Asc += WK[i] * (std::abs(FV[i] - Mean) + std::abs(FV[14-i] - Mean));
+
+            segment S;
+            S.a = a;
+            S.b = b;
+            S.Val = K * Half;
+            S.Err = std::abs((K - G) * Half);
+            Abs *= std::abs(Half);
+            Asc *= std::abs(Half);
+            if (Asc != 0 && S.Err != 0)
+                S.Err = Asc * std::min(P(1), std::pow(P(200) * S.Err / Asc, P(1.5)));
+            S.Floor = P(0);
+            if (Abs > std::numeric_limits<P>::min() / (P(50) * std::numeric_limits<P>::epsilon()))
+            {
+                S.Floor = P(50) * std::numeric_limits<P>::epsilon() * Abs;
+                S.Err = std::max(S.Floor, S.Err);
+            }
+            return S;
+        }
+
+        //Integrate over consecutive breakpoints (e.g. knots, where the integrand has kinks). All of the panels
+        //share one error budget, so effort goes where it is needed across the whole range.
+        template <class F>
+        estimate<T, P> Integrate(const std::vector<P> & Breaks, F && Cast)
+        {
+            estimate<T, P> Res = {T(0), P(0), 0, true};
+            if (Breaks.size() < 2)
+                return Res;
+
+            std::priority_queue<segment> Queue;
+            T Val = T(0);
+            for (size_t i = 0; i + 1 < Breaks.size(); i++)
+            {
+                if (Breaks[i+1] == Breaks[i])
+                    continue;
+                segment S = Panel(Breaks[i], Breaks[i+1], Cast);
+                Res.Evaluations += 15;
+                Val += S.Val;
+                Res.Error += S.Err;
+                Queue.push(S);
+            }
+
+            while (!Queue.empty() && Res.Error > Tolerance(Val))
+            {
+                if (Res.Evaluations + 30 > MaxEval)
+                {
+                    Res.Converged = false;
+                    break;
+                }
+                segment S = Queue.top();
+                P Mid = S.a + (S.b - S.a)/P(2);
+                if (Mid == S.a || Mid == S.b) //Interval can't be split any further.
+                {
+                    Res.Converged = false;
+                    break;
+                }
+                Queue.pop();
+                segment L = Panel(S.a, Mid, Cast);
+                segment R = Panel(Mid, S.b, Cast);
+                Res.Evaluations += 30;
+                Val += L.Val + R.Val - S.Val;
+                Res.Error += L.Err + R.Err - S.Err;
+                Queue.push(L);
+                Queue.push(R);
+            }
+
+            //Resum in order of position so the value doesn't carry the rounding of the running updates.
+            std::vector<segment> Final;
+            Final.reserve(Queue.size());
+            for (; !Queue.empty(); Queue.pop())
+                Final.push_back(Queue.top());
+            std::sort(Final.begin(), Final.end(), [](const segment & x, const segment & y) { return x.a < y.a; });
+            Res.Value = T(0);
+            Res.Error = P(0);
+            for (size_t i = 0; i < Final.size(); i++)
+            {
+                Res.Value += Final[i].Val;
+                Res.Error += Final[i].Err;
+            }
+            return Res;
+        }
+        template <class F>
+        estimate<T, P> Integrate(P a, P b, F && Cast)
+        {
+            return Integrate(std::vector<P>{a, b}, Cast);
+        }
+        estimate<T, P> Integrate(P a, P b, std::function<T(P)> Cast)
+        {
+            return Integrate<std::function<T(P)> &>(std::vector<P>{a, b}, Cast);
+        }
+
+        //Task parallel version for use inside an omp parallel region. One panel per break interval sets the scale
+        //for RelTol, then the tolerance is shared out in proportion to interval length and so is MaxEval (each
+        //interval gets at least its first panel). The result is the same bit-for-bit for any number of threads,
+        //but it isn't the same as Integrate.
+        template <class F>
+        estimate<T, P> Tasked(const std::vector<P> & Breaks, F && Cast)
+        {
+            estimate<T, P> Res = {T(0), P(0), 0, true};
+            if (Breaks.size() < 2 || Breaks.back() == Breaks.front())
+                return Res;
+            P Length = std::abs(Breaks.back() - Breaks.front());
+            size_t NumParts = Breaks.size() - 1;
+            std::vector<segment> First(NumParts);
+            std::vector<estimate<T, P>> Parts(NumParts, Res);
+            auto * Fun = &Cast;
+            for (size_t i = 0; i < NumParts; i++)
+                if (Breaks[i+1] != Breaks[i])
+                {
+                    #pragma omp task shared(First, Breaks) firstprivate(i, Fun) default(none)
+                    First[i] = Panel(Breaks[i], Breaks[i+1], *Fun);
+                }
+            #pragma omp taskwait
+
+            T Scale = T(0);
+            for (size_t i = 0; i < NumParts; i++)
+                if (Breaks[i+1] != Breaks[i])
+                    Scale += First[i].Val;
+            P Density = Tolerance(Scale) / Length;
+            for (size_t i = 0; i < NumParts; i++)
+                if (Breaks[i+1] != Breaks[i])
+                {
+                    size_t Budget = size_t(MaxEval * (std::abs(Breaks[i+1] - Breaks[i]) / Length));
+                    Budget = (Budget > 15 ? Budget - 15 : 0);
+                    #pragma omp task shared(Parts, First) firstprivate(i, Density, Budget, Fun) default(none)
+                    {
+                        Parts[i] = Refine(First[i], Density, MaxDepth, Budget, Fun);
+                        Parts[i].Evaluations += 15;
+                    }
+                }
+            #pragma omp taskwait
+
+            for (size_t i = 0; i < Parts.size(); i++)
+            {
+                Res.Value += Parts[i].Value;
+                Res.Error += Parts[i].Error;
+                Res.Evaluations += Parts[i].Evaluations;
+                Res.Converged = Res.Converged && Parts[i].Converged;
+            }
+            return Res;
+        }
     };
 }
 }
 
 #endif
-
@@ -0,0 +1,155 @@
+/* Cathal O Broin - cathal.obroin4 at mail.dcu.ie - 2015
+   This work is not developed in affiliation with any organisation.
+
+   This file is part of AILM.
+
+   AILM is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   AILM is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with AILM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CATHAL_MATFREE_GUARD
+#define CATHAL_MATFREE_GUARD
+#include <vector>
+#include "numeric/type.h"
+#include "util/error.h"
+#include "la/array.h"
+#include "la/slice.h"
+#include "numeric/splines.h"
+
+namespace cathal
+{
+namespace spline
+{
+//One term of a matrix free operator, <Spl1_i | Fun | Spl2_j>.
+struct term
+{
+    QSOLFunc Fun;
+    SplineKind Spl1;
+    SplineKind Spl2;
+};
+
+/*
+    Matrix free operator: the sum of the terms is applied element by element from the basis table, so nothing
+    but the table is stored. Only Row() x Column() is represented, the first IgnoreStart and last IgnoreEnd
+    splines are dropped in the same way as Shrink. Elements with the same span % k touch disjoint rows, so each
+    colour is shared out between threads without any locking.
+*/
+template <class T, class U=T>
+class matfree : public la::block<T, U>
+{
+    basis_table<T> & Table;
+    std::vector<term> Terms;
+    size_t Start;
+    std::vector<std::vector<size_t> > Colours;
+    std::vector<std::vector<T> > FW;
+
+    public :
+    matfree(basis_table<T> & Table, std::vector<term> Terms, size_t IgnoreStart = 1, size_t IgnoreEnd = 1)
+        : la::block<T, U>(Table.Size() - IgnoreStart - IgnoreEnd, Table.Size() - IgnoreStart - IgnoreEnd),
+          Table(Table), Terms(Terms), Start(IgnoreStart), Colours(Table.Order()), FW(this->Terms.size())
+    {
+        for (size_t e = 0; e < Table.Elements(); e++)
+            Colours[Table.Span(e) % Table.Order()].push_back(e);
+        //Fun(x_q) w_q is fixed, so it is worked out once rather than on every product.
+        for (size_t t = 0; t < this->Terms.size(); t++)
+            FW[t] = WeightedFunction(Table, this->Terms[t].Fun);
+    }
+    //The size of the band it stands in for, for working out calculation complexity.
+    size_t NumElem()
+    {
+        return this->N*(2*Table.Order()-1);
+    }
+    //There are no stored elements, needing one is a sign of an algorithm problem.
+    T & operator()(int)
+    {
+        throw(OUT_OF_BOUNDS);
+    }
+    T & operator()(int, int)
+    {
+        throw(OUT_OF_BOUNDS);
+    }
+
+    //y = A x
+    void Apply(U * x, U * y)
+    {
+        int k = Table.Order();
+        int Nq = Table.Points();
+        int First = Start;
+        int Last = Start + this->N;
+        int NumColours = Colours.size();
+        int NumTerms = Terms.size();
+        std::fill(y, y + this->N, U(0));
+
+#pragma omp parallel shared(x, y) firstprivate(k, Nq, First, Last, NumColours, NumTerms) default(none)
+        {
+            U Xl[MaxOrder], Local[MaxOrder];
+            for (int c = 0; c < NumColours; c++)
+            {
+                int NumElem = Colours[c].size();
+#pragma omp for schedule(static)
+                for (int n = 0; n < NumElem; n++)
+                {
+                    size_t e = Colours[c][n];
+                    int Off = int(Table.Span(e)) - k + 1;
+                    for (int r = 0; r < k; r++)
+                    {
+                        int Row = Off + r;
+                        Xl[r] = (Row >= First && Row < Last ? x[Row - First] : U(0));
+                        Local[r] = U(0);
+                    }
+
+                    const T * B = Table.B(e);
+                    const T * DB = Table.DB(e);
+                    for (int q = 0; q < Nq; q++)
+                    {
+                        U uB = U(0), uD = U(0);
+                        for (int r = 0; r < k; r++)
+                        {
+                            uB += B[q*k + r] * Xl[r];
+                            uD += DB[q*k + r] * Xl[r];
+                        }
+                        U gB = U(0), gD = U(0);
+                        for (int t = 0; t < NumTerms; t++)
+                        {
+                            U Val = FW[t][e*Nq + q] * (Terms[t].Spl2 == BSPLINE ? uB : uD);
+                            if (Terms[t].Spl1 == BSPLINE)
+                                gB += Val;
+                            else
+                                gD += Val;
+                        }
+                        for (int r = 0; r < k; r++)
+                            Local[r] += gB * B[q*k + r] + gD * DB[q*k + r];
+                    }
+
+                    for (int r = 0; r < k; r++)
+                    {
+                        int Row = Off + r;
+                        if (Row >= First && Row < Last)
+                            y[Row - First] += Local[r];
+                    }
+                }
+            }
+        }
+    }
+    la::slice<U> operator*(la::slice<U> B)
+    {
+        la::slice<U> A(this->N);
+        if (B.Size() != this->M)
+            throw(SIZE_MISMATCH);
+        if (this->N)
+            Apply(&*B.begin(), &*A.begin());
+        return A;
+    }
+};
+}
+}
+#endif
@@ -18,7 +18,11 @@
 */
 #ifndef CATHAL_SEQ_GUARD
 #define CATHAL_SEQ_GUARD
+#include <functional>
+#include <algorithm>
+#include <cmath>
 #include "numeric/type.h"
+#include "util/error.h"
 namespace cathal
 {
     namespace sequences
@@ -57,7 +61,123 @@ namespace cathal
                 return (dt*StepNum >= Duration);
             }
         };
+        //Steps grown and shrunk from the error estimate of each one, Err <= Tol accepts. Err ~ dt^(Order+1) so
+        //the next step is dt (Tol/Err)^(1/(Order+1)) with a safety factor. Next() proposes the end of a step from
+        //Time(), Accept() moves on or, for a rejected step, shrinks it so the next Next() retries from the same
+        //time. A field hint caps the step at Fraction Peak/|dE/dt|, where Peak is the largest |E| met so far (so
+        //the field changes by at most that fraction of its scale without stalling at the carrier's zeros). Where
+        //the field stays under Threshold the step is Quiet(): it runs up to MaxDt or to where the field rises,
+        //needs no estimate and is passed over with Skip(). Quiet steps leave the estimate driven step alone, so
+        //the first step after them starts from the last one the error allowed.
+        class adaptive : public sequence
+        {
+            private :
+            real t = 0, dt, Len = 0, Tol, MinDt, MaxDt;
+            int Order;
+            std::function<real(real)> Field;
+            real Threshold = 0, Resolution = 1, Fraction = 0.1, Peak = 0;
+            bool IsQuiet = false;
+            unsigned int NumAccepted = 0, NumRejected = 0, NumSkipped = 0;
+
+            real Cap(real Dt)
+            {
+                if (!Field)
+                    return Dt;
+                real h = std::max(Dt * real(1e-3), real(1e-8));
+                real DE = std::abs(Field(t + h) - Field(t - h)) / (2 * h);
+                Peak = std::max(Peak, std::abs(Field(t)));
+                if (DE > 0)
+                    Dt = std::min(Dt, Fraction * std::max(Peak, Threshold) / DE);
+                return Dt;
+            }
+            public :
+            adaptive(real end, real Dt, real Tol, int Order = 2, real MinDt = 1e-10, real MaxDt = 0) : sequence(end), dt(Dt), Tol(Tol), MinDt(MinDt), MaxDt(MaxDt > 0 ? MaxDt : end), Order(Order)
+            {
+            }
+            //Resolution is the spacing the field is sampled at, finer than the rise of any pulse.
+            void Hint(std::function<real(real)> E, real Threshold, real Resolution, real Fraction = 0.1)
+            {
+                Field = E;
+                this->Threshold = Threshold;
+                this->Resolution = Resolution;
+                this->Fraction = Fraction;
+            }
+            real Time()
+            {
+                return t;
+            }
+            //Length of the step Next() last proposed.
+            real Step()
+            {
+                return Len;
+            }
+            real Next()
+            {
+                //Quiet if the field stays under Threshold at every sample, or up to the sample before it rises.
+                IsQuiet = false;
+                if (Field)
+                {
+                    real Span = std::min(MaxDt, Duration - t);
+                    int K = std::max(1, int(std::ceil(Span / Resolution)));
+                    int q = 0;
+                    while (q <= K && std::abs(Field(t + Span * q / K)) < Threshold)
+                        q++;
+                    if (q > 1)
+                    {
+                        Len = (q > K ? Span : Span * (q-1) / K);
+                        IsQuiet = true;
+                        return t + Len;
+                    }
+                }
+                Len = std::max(std::min({dt, MaxDt, Cap(dt)}), MinDt);
+                if (t + real(1.01) * Len >= Duration) //No sliver of a last step.
+                    Len = Duration - t;
+                return t + Len;
+            }
+            bool Quiet()
+            {
+                return IsQuiet;
+            }
+            //Moves past a quiet step, it is not counted as accepted and leaves the step size as it was.
+            void Skip()
+            {
+                t += Len;
+                NumSkipped++;
+            }
+            bool Accept(real Err)
+            {
+                real Factor = (Err > 0 ? real(0.9) * std::pow(Tol / Err, real(1) / (Order + 1)) : real(5));
+                Factor = std::min(std::max(Factor, real(0.2)), real(5));
+                if (Err <= Tol)
+                {
+                    t += Len;
+                    dt = Len * Factor;
+                    NumAccepted++;
+                    return true;
+                }
+                if (Len <= MinDt)
+                    throw(NOT_CONVERGED);
+                dt = std::max(Len * Factor, MinDt);
+                NumRejected++;
+                return false;
+            }
+            bool End()
+            {
+                return (t >= Duration);
+            }
+            unsigned int Accepted()
+            {
+                return NumAccepted;
+            }
+            unsigned int Rejected()
+            {
+                return NumRejected;
+            }
+            unsigned int Skipped()
+            {
+                return NumSkipped;
+            }
+        };
     }
 }
 #endif
-
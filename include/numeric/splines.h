@@ -21,7 +21,10 @@
 
 #include <vector>
 #include <functional>
+#include <algorithm>
 #include "numeric/type.h"
+#include "util/error.h"
+#include "numeric/integrate.h"
 #include "la/array.h"
 namespace cathal
 {
@@ -68,10 +71,425 @@ T DBSpline(size_t k, size_t i, real x, std::vector<T> & Knots)
     return (real)(k-1)*((A ? BS1/A : 0.0) - (B ? BS2/B : 0.0));
 }
 
+//Selects B_i or its derivative in the routines that evaluate every active spline in one pass.
+typedef enum
+{
+    BSPLINE,
+    DBSPLINE
+} SplineKind;
+
+//Upper bound on k for the stack workspace used by ActiveBSplines.
+const size_t MaxOrder = 24;
+
+//Non-recursive (triangular) de Boor evaluation of the k B-splines that are non-zero on [Knots[Span], Knots[Span+1]).
+//B[r] = B_{Span-k+1+r}(x) and, if DB is given, DB[r] = B'_{Span-k+1+r}(x). O(k^2) rather than O(2^k).
+//Knots outside of the vector are clamped to the ends, this only affects splines with an index outside of the basis.
+//K fixes the order at compile time so the loops can be unrolled, K = 0 is the generic version using k.
+template <int K, class T>
+void DeBoor(int k, size_t Span, real x, std::vector<T> & Knots, T * B, T * DB)
+{
+    const int Kc = (K ? K : k);
+    int Last = int(Knots.size()) - 1;
+    auto Knot = [&Knots, Last](int m) -> T { return Knots[std::min(std::max(m, 0), Last)]; };
+    T Left[K ? K : MaxOrder], Right[K ? K : MaxOrder];
+    int S = int(Span);
+
+    B[0] = T(1);
+    if (DB && Kc == 1)
+        DB[0] = T(0);
+    for (int j = 1; j < Kc; j++)
+    {
+        //B holds the order k-1 splines, which is all the derivative needs.
+        if (DB && j == Kc-1)
+            for (int r = 0; r < Kc; r++)
+            {
+                T A = Knot(S+r) - Knot(S-Kc+1+r);
+                T C = Knot(S+r+1) - Knot(S-Kc+2+r);
+                DB[r] = T(Kc-1) * ((r > 0 && A ? B[r-1]/A : T(0)) - (r < Kc-1 && C ? B[r]/C : T(0)));
+            }
+
+        Left[j] = x - Knot(S+1-j);
+        Right[j] = Knot(S+j) - x;
+        T Saved = T(0);
+        for (int r = 0; r < j; r++)
+        {
+            T Den = Right[r+1] + Left[j-r];
+            T Temp = Den ? B[r]/Den : T(0);
+            B[r] = Saved + Right[r+1]*Temp;
+            Saved = Left[j-r]*Temp;
+        }
+        B[j] = Saved;
+    }
+}
+
+//Dispatches to the fixed order evaluator for the orders in use, with the generic one as a fallback.
+template <class T>
+void ActiveBSplines(size_t k, size_t Span, real x, std::vector<T> & Knots, T * B, T * DB = nullptr)
+{
+    switch (k)
+    {
+        case 3 : DeBoor<3>(k, Span, x, Knots, B, DB); break;
+        case 4 : DeBoor<4>(k, Span, x, Knots, B, DB); break;
+        case 5 : DeBoor<5>(k, Span, x, Knots, B, DB); break;
+        case 6 : DeBoor<6>(k, Span, x, Knots, B, DB); break;
+        case 7 : DeBoor<7>(k, Span, x, Knots, B, DB); break;
+        case 8 : DeBoor<8>(k, Span, x, Knots, B, DB); break;
+        case 9 : DeBoor<9>(k, Span, x, Knots, B, DB); break;
+        case 10 : DeBoor<10>(k, Span, x, Knots, B, DB); break;
+        case 11 : DeBoor<11>(k, Span, x, Knots, B, DB); break;
+        case 12 : DeBoor<12>(k, Span, x, Knots, B, DB); break;
+        default :
+            if (k > MaxOrder)
+                throw(OUT_OF_BOUNDS);
+            DeBoor<0>(k, Span, x, Knots, B, DB);
+    }
+}
+
+//Batched version for many points within the same knot interval, B and DB are laid out point by point (X.size() by k).
+template <class T>
+void ActiveBSplines(size_t k, size_t Span, std::vector<T> & X, std::vector<T> & Knots, std::vector<T> & B, std::vector<T> * DB = nullptr)
+{
+    B.resize(X.size()*k);
+    if (DB)
+        DB->resize(X.size()*k);
+    for (size_t q = 0; q < X.size(); q++)
+        ActiveBSplines(k, Span, X[q], Knots, &B[q*k], DB ? &(*DB)[q*k] : nullptr);
+}
+
+//Integral of Fun * Spl1_i * Spl2_j over the knot intervals where both splines are non-zero.
+template <class T, class P, class F>
+T PairIntegral(quadrature::gauss<T, P> & Gauss, std::vector<P> & Knots, int k, int i, int j, F & Fun, SplineKind Spl1, SplineKind Spl2)
+{
+    bool Deriv = (Spl1 == DBSPLINE || Spl2 == DBSPLINE);
+    int Last = std::min(std::min(i, j) + k-1, int(Knots.size()) - 2);
+    T B[MaxOrder], DB[MaxOrder];
+    T * S1 = (Spl1 == BSPLINE ? B : DB);
+    T * S2 = (Spl2 == BSPLINE ? B : DB);
+
+    T Sum = T(0);
+    for (int bps = std::max(i, j); bps <= Last; bps++)
+    {
+        if (Knots[bps] == Knots[bps+1])
+            continue;
+        int Off = bps - k+1;
+        Sum += Gauss.Quad(Knots[bps], Knots[bps+1], [&](P x) -> T
+        {
+            ActiveBSplines(k, bps, x, Knots, B, Deriv ? DB : nullptr);
+            return Fun(x) * S1[i-Off] * S2[j-Off];
+        });
+    }
+    return Sum;
+}
+
+/*
+    Tabulated basis: the mapped Gauss nodes, weights and the values of the k active splines (and derivatives) on
+    every knot interval of non-zero length (an element). Built once per knot set and shared by every operator.
+    Element e covers [Knots[Span(e)], Knots[Span(e)+1]), its Points() nodes and weights are contiguous and
+    B(e)[q*k + r] = B_{Span(e)-k+1+r}(X(e)[q]).
+*/
+template <class T>
+class basis_table
+{
+    private :
+    size_t k, Nq, Ns;
+    std::vector<T> Knots;
+    std::vector<size_t> Spans;
+    std::vector<int> Elem;  //Element index of each knot interval, -1 if the interval has zero length
+    std::vector<T> Xq, Wq, Bq, DBq;
+
+    public :
+    template <class P>
+    basis_table(quadrature::gauss<T, P> & Gauss, std::vector<T> & Kn, size_t k) : basis_table(Gauss, Kn, k, 0, Kn.size() - 1)
+    {
+    }
+    //Only the knot intervals [FirstSpan, EndSpan) are tabulated, for work that is local to part of the basis.
+    template <class P>
+    basis_table(quadrature::gauss<T, P> & Gauss, std::vector<T> & Kn, size_t k, size_t FirstSpan, size_t EndSpan)
+        : k(k), Nq(Gauss.Order()), Ns(Kn.size() - k), Knots(Kn), Elem(Kn.size() - 1, -1)
+    {
+        if (k > MaxOrder || Kn.size() < k+1 || EndSpan > Kn.size() - 1)
+            throw(OUT_OF_BOUNDS);
+
+        for (size_t m = FirstSpan; m < EndSpan; m++)
+            if (Knots[m] != Knots[m+1])
+            {
+                Elem[m] = Spans.size();
+                Spans.push_back(m);
+            }
+
+        size_t Ne = Spans.size();
+        Xq.resize(Ne*Nq);
+        Wq.resize(Ne*Nq);
+        Bq.resize(Ne*Nq*k);
+        DBq.resize(Ne*Nq*k);
+
+#pragma omp parallel for shared(Gauss) firstprivate(Ne, k) default(none)
+        for (size_t e = 0; e < Ne; e++)
+        {
+            std::vector<P> X;
+            std::vector<T> W;
+            Gauss.Map(Knots[Spans[e]], Knots[Spans[e]+1], X, W);
+            std::copy(X.begin(), X.end(), this->X(e));
+            std::copy(W.begin(), W.end(), this->W(e));
+            for (size_t q = 0; q < Nq; q++)
+                ActiveBSplines(k, Spans[e], X[q], Knots, B(e) + q*k, DB(e) + q*k);
+        }
+    }
+
+    size_t Order()
+    {
+        return k;
+    }
+    size_t Points()
+    {
+        return Nq;
+    }
+    size_t Elements()
+    {
+        return Spans.size();
+    }
+    //Number of splines in the basis.
+    size_t Size()
+    {
+        return Ns;
+    }
+    size_t Span(size_t e)
+    {
+        return Spans[e];
+    }
+    int Element(size_t Span)
+    {
+        return Elem[Span];
+    }
+    std::vector<T> & KnotVector()
+    {
+        return Knots;
+    }
+    T * X(size_t e)
+    {
+        return &Xq[e*Nq];
+    }
+    T * W(size_t e)
+    {
+        return &Wq[e*Nq];
+    }
+    T * B(size_t e)
+    {
+        return &Bq[e*Nq*k];
+    }
+    T * DB(size_t e)
+    {
+        return &DBq[e*Nq*k];
+    }
+    T * Values(size_t e, SplineKind Spl)
+    {
+        return (Spl == BSPLINE ? B(e) : DB(e));
+    }
+};
+
+//Fun * weight at every node of the table, evaluated once per operator.
+template <class T>
+std::vector<T> WeightedFunction(basis_table<T> & Table, QSOLFunc & Fun)
+{
+    size_t Nq = Table.Points();
+    std::vector<T> FW(Table.Elements()*Nq);
+    for (size_t e = 0; e < Table.Elements(); e++)
+        for (size_t q = 0; q < Nq; q++)
+            FW[e*Nq + q] = Fun(Table.X(e)[q]) * Table.W(e)[q];
+    return FW;
+}
+
+//One output of a fused assembly, Out(i, j) = <Spl1_i | Fun | Spl2_j>.
+template <class T>
+struct operand
+{
+    la::block<T> * Out;
+    QSOLFunc Fun;
+    SplineKind Spl1;
+    SplineKind Spl2;
+    bool Symm;
+};
+
+//Local k by k matrices of every operand on element e, Local holds Ops.size() of them.
+//K fixes the order at compile time so the inner loops can be unrolled, K = 0 is the generic version.
+template <int K, class T>
+void LocalMatrices(basis_table<T> & Table, std::vector<operand<T> > & Ops, std::vector<std::vector<T> > & FW, int e, T * Local)
+{
+    const int k = (K ? K : Table.Order());
+    int Nq = Table.Points(), No = Ops.size();
+    std::fill(Local, Local + No*k*k, T(0));
+    for (int q = 0; q < Nq; q++)
+    {
+        T * B = Table.B(e) + q*k;
+        T * DB = Table.DB(e) + q*k;
+        for (int o = 0; o < No; o++)
+        {
+            T * S1 = (Ops[o].Spl1 == BSPLINE ? B : DB);
+            T * S2 = (Ops[o].Spl2 == BSPLINE ? B : DB);
+            T * L = Local + o*k*k;
+            T F = FW[o][e*Nq + q];
+            for (int r = 0; r < k; r++)
+            {
+                T A = F * S1[r];
+                for (int c = (Ops[o].Symm ? r : 0); c < k; c++)
+                    L[r*k + c] += A * S2[c];
+            }
+        }
+    }
+}
+
+template <class T>
+using local_kernel = void (*)(basis_table<T> &, std::vector<operand<T> > &, std::vector<std::vector<T> > &, int, T *);
+
+template <class T>
+local_kernel<T> SelectKernel(int k)
+{
+    switch (k)
+    {
+        case 3 : return LocalMatrices<3, T>;
+        case 4 : return LocalMatrices<4, T>;
+        case 5 : return LocalMatrices<5, T>;
+        case 6 : return LocalMatrices<6, T>;
+        case 7 : return LocalMatrices<7, T>;
+        case 8 : return LocalMatrices<8, T>;
+        case 9 : return LocalMatrices<9, T>;
+        case 10 : return LocalMatrices<10, T>;
+        case 11 : return LocalMatrices<11, T>;
+        case 12 : return LocalMatrices<12, T>;
+        default : return LocalMatrices<0, T>;
+    }
+}
+
+//Element by element assembly of several operators in one sweep. Each element is integrated once, the tabulated
+//spline values at a node are loaded once for every operator, and each k by k local matrix is scattered into its output.
+//Elements whose spans are equal mod k touch disjoint rows, so each such colour is a parallel loop in which no two
+//threads write the same entry. Symmetric operands only compute the upper half of their local matrix.
+//With a row range [First, Last) only the entries (i, j) with i or j in it are zeroed and assembled, the rest are left alone.
+template <class T>
+void Assemble(basis_table<T> & Table, std::vector<operand<T> > & Ops, int First = 0, int Last = -1)
+{
+    int k = Table.Order(), Ne = Table.Elements(), No = Ops.size();
+    if (Last < 0)
+        Last = Table.Size();
+    auto Touched = [First, Last](int i, int j) { return (i >= First && i < Last) || (j >= First && j < Last); };
+    local_kernel<T> Kernel = SelectKernel<T>(k);
+    std::vector<std::vector<T> > FW(No);
+    for (int o = 0; o < No; o++)
+    {
+        FW[o] = WeightedFunction(Table, Ops[o].Fun);
+        la::block<T> & Out = *Ops[o].Out;
+        int Ns = Out.Row();
+        for (int i = 0; i < Ns; i++)
+            for (int j = std::max(0, i-k+1); j < std::min(Ns, i+k); j++)
+                if (Touched(i, j))
+                    Out(i, j) = T(0);
+    }
+    std::vector<std::vector<int> > Colours(k);
+    for (int e = 0; e < Ne; e++)
+        Colours[Table.Span(e) % k].push_back(e);
+
+#pragma omp parallel shared(Table, Ops, FW, Colours) firstprivate(k, No, Kernel, Touched) default(none)
+    {
+        std::vector<T> Local(No*k*k);
+        for (int Colour = 0; Colour < k; Colour++)
+        {
+            int NumElem = Colours[Colour].size();
+#pragma omp for
+            for (int n = 0; n < NumElem; n++)
+            {
+                int e = Colours[Colour][n];
+                int Span = Table.Span(e);
+
+                Kernel(Table, Ops, FW, e, &Local[0]);
+
+                int Off = Span - k+1;
+                for (int o = 0; o < No; o++)
+                {
+                    la::block<T> & Out = *Ops[o].Out;
+                    bool Symm = Ops[o].Symm;
+                    int Ns = Out.Row();
+                    T * L = &Local[o*k*k];
+                    for (int r = std::max(0, -Off); r < k && Off+r < Ns; r++)
+                        for (int c = (Symm ? r : std::max(0, -Off)); c < k && Off+c < Ns; c++)
+                        {
+                            if (!Touched(Off+r, Off+c))
+                                continue;
+                            Out(Off+r, Off+c) += L[r*k + c];
+                            if (Symm && c != r)
+                                Out(Off+c, Off+r) += L[r*k + c];
+                        }
+                }
+            }
+        }
+    }
+}
+
+template <class T>
+void Assemble(basis_table<T> & Table, la::block<T> & SplineOverlap, QSOLFunc Fun, SplineKind Spl1, SplineKind Spl2, bool Symm = false)
+{
+    std::vector<operand<T> > Ops = {{&SplineOverlap, Fun, Spl1, Spl2, Symm}};
+    Assemble(Table, Ops);
+}
+
+//Rebuilds the operators for NewKnots from Old, the same operators on OldKnots (Ops[o] matches Old[o], all unshrunk).
+//Splines whose knots all lie in the common prefix, or common suffix, of the two knot vectors are unchanged, so any
+//entry between two of them is copied (the suffix moves with the change in length). Only the entries touching a
+//changed spline are integrated, with a table over the elements they cover. Returns the number of changed splines.
 template <class T, class P>
-void Overlap(quadrature::gauss<T, P> & Gauss, std::vector<P> & Knots, int k, la::block<T> & SplineOverlap, QuadFunc Fun)
+size_t Reassemble(quadrature::gauss<T, P> & Gauss, std::vector<T> & OldKnots, std::vector<la::band<T> *> Old, std::vector<T> & NewKnots,
+                  size_t k, std::vector<operand<T> > & Ops)
+{
+    if (Old.size() != Ops.size())
+        throw(SIZE_MISMATCH);
+    int NO = OldKnots.size(), NN = NewKnots.size();
+    int Shift = NN - NO;
+    int Ns = NN - k;
+
+    int Prefix = 0;
+    while (Prefix < std::min(NO, NN) && OldKnots[Prefix] == NewKnots[Prefix])
+        Prefix++;
+    int Suffix = 0;
+    while (Prefix + Suffix < std::min(NO, NN) && OldKnots[NO-1-Suffix] == NewKnots[NN-1-Suffix])
+        Suffix++;
+
+    //Changed splines are [First, Last), spline i depends on knots i to i+k.
+    int First = std::max(0, Prefix - int(k));
+    int Last = std::max(First, std::min(Ns, NN - Suffix));
+    auto OldIndex = [First, Shift](int i) { return (i < First ? i : i - Shift); };
+
+    for (size_t o = 0; o < Ops.size(); o++)
+    {
+        la::block<T> & Out = *Ops[o].Out;
+        la::band<T> & In = *Old[o];
+        int Ko = In.Order(), NsOld = In.Row();
+        for (int i = 0; i < Ns; i++)
+        {
+            if (i >= First && i < Last)
+                continue;
+            for (int j = std::max(0, i-int(k)+1); j < std::min(Ns, i+int(k)); j++)
+            {
+                if (j >= First && j < Last)
+                    continue;
+                int oi = OldIndex(i), oj = OldIndex(j);
+                bool Stored = (oi >= 0 && oj >= 0 && oi < NsOld && oj < NsOld && std::abs(oi - oj) < Ko);
+                Out(i, j) = (Stored ? In(oi, oj) : T(0));
+            }
+        }
+    }
+
+    if (First < Last)
+    {
+        basis_table<T> Table(Gauss, NewKnots, k, First, std::min(size_t(Last) + k - 1, NewKnots.size() - 1));
+        Assemble(Table, Ops, First, Last);
+    }
+    return Last - First;
+}
+
+//The integrands are template parameters so the quadrature loops can inline them, the QuadFunc overloads
+//are thin wrappers for type-erased callers.
+template <class T, class P, class F>
+void Overlap(quadrature::gauss<T, P> & Gauss, std::vector<P> & Knots, int k, la::block<T> & SplineOverlap, F Fun)
 {
-    using namespace std::placeholders;
     int Ns = SplineOverlap.Row();
 #pragma omp parallel for shared(Fun, Gauss, SplineOverlap, Knots) firstprivate(Ns, k) default(none)
     for (int i = 0; i < Ns; i++)
@@ -80,18 +498,22 @@ void Overlap(quadrature::gauss<T, P> & Gauss, std::vector<P> & Knots, int k, la:
             real Sum = 0.0;
             int Min = std::max(std::min(i, j) - k+1, 0);
             for (int bps = Min; bps < Min+2*k-1; bps++)
-                Sum += Gauss.Quad(Knots[bps], Knots[bps+1], std::bind(Fun, i, j, _1));
+                Sum += Gauss.Quad(Knots[bps], Knots[bps+1], [&](P x) -> T { return Fun(i, j, x); });
             SplineOverlap(i, j) = Sum;
         }
 }
+template <class T, class P>
+void Overlap(quadrature::gauss<T, P> & Gauss, std::vector<P> & Knots, int k, la::block<T> & SplineOverlap, QuadFunc Fun)
+{
+    Overlap<T, P, QuadFunc &>(Gauss, Knots, k, SplineOverlap, Fun);
+}
 
 //Same functionality as above except optimised for symmetric problems (when <i|O|j> == <j|O|i>)
 //Tested on k=3, 100,000 by 100,000 for speed, ~30% reduction in run time (openmp disabled)
 //Tested on k=9, 1,000 by 1,000 for speed, ~30% reduction in run time (openmp disabled)
-template <class T, class P>
-void SymmOverlap(quadrature::gauss<T, P> & Gauss, std::vector<P> & Knots, int k, la::block<T> & SplineOverlap, QuadFunc Fun)
+template <class T, class P, class F>
+void SymmOverlap(quadrature::gauss<T, P> & Gauss, std::vector<P> & Knots, int k, la::block<T> & SplineOverlap, F Fun)
 {
-    using namespace std::placeholders;
     int Ns = SplineOverlap.Row();
 
 #pragma omp parallel for shared(Fun, Gauss, SplineOverlap, Knots) firstprivate(Ns, k) default(none)
@@ -101,48 +523,132 @@ void SymmOverlap(quadrature::gauss<T, P> & Gauss, std::vector<P> & Knots, int k,
 
         real Sum = 0.0;
         for (int bps = Min; bps < Min+2*k-1; bps++)
-            Sum += Gauss.Quad(Knots[bps], Knots[bps+1], std::bind(Fun, i, i, _1));
+            Sum += Gauss.Quad(Knots[bps], Knots[bps+1], [&](P x) -> T { return Fun(i, i, x); });
         SplineOverlap(i, i) = Sum;
 
         for (int j = i+1; j < std::min(Ns, i+k); j++)
         {
             real Sum = 0.0;
             for (int bps = Min; bps < Min+2*k-1; bps++)
-                Sum += Gauss.Quad(Knots[bps], Knots[bps+1], std::bind(Fun, i, j, _1));
+                Sum += Gauss.Quad(Knots[bps], Knots[bps+1], [&](P x) -> T { return Fun(i, j, x); });
             SplineOverlap(i, j) = SplineOverlap(j, i) = Sum;
         }
     }
 }
 template <class T, class P>
-void AdaptiveOverlap(quadrature::gauss<T, P> & Gauss, std::vector<P> & Knots, int k, la::block<T> & SplineOverlap, QuadFunc Fun)
+void SymmOverlap(quadrature::gauss<T, P> & Gauss, std::vector<P> & Knots, int k, la::block<T> & SplineOverlap, QuadFunc Fun)
 {
-    using namespace std::placeholders;
-    int Ns = SplineOverlap.Row();
-    #pragma omp parallel for shared(std::cout, Fun, Gauss, SplineOverlap, Knots) firstprivate(Ns, k) default(none)
+    SymmOverlap<T, P, QuadFunc &>(Gauss, Knots, k, SplineOverlap, Fun);
+}
+//Adaptive versions use Gauss-Kronrod with the knots as breakpoints, the total number of integrand calls is returned.
+//Every element is a task and refinement inside it spawns more (kronrod::Tasked), so the work near r=0 is spread
+//over all of the threads rather than landing on whichever owns the first rows.
+template <class T, class P, class G>
+size_t AdaptiveTasks(int Ns, int k, la::block<T> & SplineOverlap, G Entry)
+{
+    size_t Evals = 0;
+    #pragma omp parallel shared(SplineOverlap, Entry, Evals) firstprivate(Ns, k) default(none)
+    #pragma omp single
     for (int i = 0; i < Ns; i++)
-    {
         for (int j = std::max(0, i-k+1); j < std::min(Ns, i+k); j++)
         {
-            int Start = std::max(std::min(i, j) - k+1, 0);
-            int End = Start + 2*k-1;
-            real Sum = 0.0;
-
-            SplineOverlap(i, j) = Gauss.Adaptive(1e-16, Knots[Start], Knots[End], std::bind(Fun, i, j, _1));
+            #pragma omp task shared(SplineOverlap, Entry, Evals) firstprivate(i, j) default(none)
+            {
+                quadrature::estimate<T, P> Res = Entry(i, j);
+                SplineOverlap(i, j) = Res.Value;
+                #pragma omp atomic
+                Evals += Res.Evaluations;
+            }
         }
-    }
+    return Evals;
 }
-template <class T, class P>
-void AdaptiveOverlap(quadrature::gauss<T, P> & Gauss, std::vector<P> & Knots, int k, la::block<T> & SplineOverlap, QSOLFunc Fun, spl Spl1, spl Spl2)
+template <class T, class P, class F>
+size_t AdaptiveOverlap(quadrature::kronrod<T, P> & Kronrod, std::vector<P> & Knots, int k, la::block<T> & SplineOverlap, F Fun)
 {
-    AdaptiveOverlap(Gauss, Knots, k, SplineOverlap, [&](int i, int j, real x) -> real { return Fun(x) * Spl1(k, i, x, Knots) * Spl2(k, j, x, Knots);});
+    int NKnots = Knots.size();
+    return AdaptiveTasks<T, P>(SplineOverlap.Row(), k, SplineOverlap, [&](int i, int j)
+    {
+        int Start = std::max(std::min(i, j) - k+1, 0);
+        int End = std::min(Start + 2*k-1, NKnots-1);
+
+        std::vector<P> Breaks(Knots.begin() + Start, Knots.begin() + End + 1);
+        return Kronrod.Tasked(Breaks, [&](P x) -> T { return Fun(i, j, x); });
+    });
 }
 template <class T, class P>
-void SymmOverlap(quadrature::gauss<T, P> & Gauss, std::vector<P> & Knots, int k, la::block<T> & SplineOverlap, QSOLFunc Fun, spl Spl1, spl Spl2)
+size_t AdaptiveOverlap(quadrature::kronrod<T, P> & Kronrod, std::vector<P> & Knots, int k, la::block<T> & SplineOverlap, QuadFunc Fun)
+{
+    return AdaptiveOverlap<T, P, QuadFunc &>(Kronrod, Knots, k, SplineOverlap, Fun);
+}
+//The SplineKind overloads evaluate all of the active splines at once with ActiveBSplines.
+template <class T, class P, class F>
+void Overlap(quadrature::gauss<T, P> & Gauss, std::vector<P> & Knots, int k, la::block<T> & SplineOverlap, F Fun, SplineKind Spl1, SplineKind Spl2)
+{
+    int Ns = SplineOverlap.Row();
+#pragma omp parallel for shared(Fun, Gauss, SplineOverlap, Knots) firstprivate(Ns, k, Spl1, Spl2) default(none)
+    for (int i = 0; i < Ns; i++)
+        for (int j = std::max(0, i-k+1); j < std::min(Ns, i+k); j++)
+            SplineOverlap(i, j) = PairIntegral(Gauss, Knots, k, i, j, Fun, Spl1, Spl2);
+}
+template <class T, class P, class F>
+void SymmOverlap(quadrature::gauss<T, P> & Gauss, std::vector<P> & Knots, int k, la::block<T> & SplineOverlap, F Fun, SplineKind Spl1, SplineKind Spl2)
+{
+    int Ns = SplineOverlap.Row();
+#pragma omp parallel for shared(Fun, Gauss, SplineOverlap, Knots) firstprivate(Ns, k, Spl1, Spl2) default(none)
+    for (int i = 0; i < Ns; i++)
+        for (int j = i; j < std::min(Ns, i+k); j++)
+            SplineOverlap(i, j) = SplineOverlap(j, i) = PairIntegral(Gauss, Knots, k, i, j, Fun, Spl1, Spl2);
+}
+//Tabulated versions, the splines are not re-evaluated for each operator and each element is only integrated once.
+template <class T>
+void Overlap(basis_table<T> & Table, la::block<T> & SplineOverlap, QSOLFunc Fun, SplineKind Spl1, SplineKind Spl2)
+{
+    Assemble(Table, SplineOverlap, Fun, Spl1, Spl2);
+}
+template <class T>
+void SymmOverlap(basis_table<T> & Table, la::block<T> & SplineOverlap, QSOLFunc Fun, SplineKind Spl1, SplineKind Spl2)
+{
+    Assemble(Table, SplineOverlap, Fun, Spl1, Spl2, true);
+}
+template <class T, class P, class F>
+size_t AdaptiveOverlap(quadrature::kronrod<T, P> & Kronrod, std::vector<P> & Knots, int k, la::block<T> & SplineOverlap, F Fun, SplineKind Spl1, SplineKind Spl2)
+{
+    bool Deriv = (Spl1 == DBSPLINE || Spl2 == DBSPLINE);
+    return AdaptiveTasks<T, P>(SplineOverlap.Row(), k, SplineOverlap, [&](int i, int j)
+    {
+        //Integrate over the common support only, the span search is then at most k intervals long.
+        int First = std::max(i, j);
+        int Last = std::min(std::min(i, j) + k-1, int(Knots.size()) - 2);
+
+        std::vector<P> Breaks(Knots.begin() + First, Knots.begin() + Last + 2);
+        return Kronrod.Tasked(Breaks, [&](P x) -> T
+        {
+            int Span = First;
+            while (Span < Last && Knots[Span+1] <= x)
+                Span++;
+            if (x < Knots[Span] || x > Knots[Span+1] || Knots[Span] == Knots[Span+1])
+                return T(0);
+            T B[MaxOrder], DB[MaxOrder]; //Per call, the panels of one element can run on different threads.
+            T * S1 = (Spl1 == BSPLINE ? B : DB);
+            T * S2 = (Spl2 == BSPLINE ? B : DB);
+            ActiveBSplines(k, Span, x, Knots, B, Deriv ? DB : nullptr);
+            return Fun(x) * S1[i-Span+k-1] * S2[j-Span+k-1];
+        });
+    });
+}
+//Reference versions with arbitrary spline functions (e.g. BSpline<real> and DBSpline<real>).
+template <class T, class P, class F, class S1, class S2>
+size_t AdaptiveOverlap(quadrature::kronrod<T, P> & Kronrod, std::vector<P> & Knots, int k, la::block<T> & SplineOverlap, F Fun, S1 Spl1, S2 Spl2)
+{
+    return AdaptiveOverlap(Kronrod, Knots, k, SplineOverlap, [&](int i, int j, real x) -> real { return Fun(x) * Spl1(k, i, x, Knots) * Spl2(k, j, x, Knots);});
+}
+template <class T, class P, class F, class S1, class S2>
+void SymmOverlap(quadrature::gauss<T, P> & Gauss, std::vector<P> & Knots, int k, la::block<T> & SplineOverlap, F Fun, S1 Spl1, S2 Spl2)
 {
     SymmOverlap(Gauss, Knots, k, SplineOverlap, [&](int i, int j, real x) -> real { return Fun(x) * Spl1(k, i, x, Knots) * Spl2(k, j, x, Knots);});
 }
-template <class T, class P>
-void Overlap(quadrature::gauss<T, P> & Gauss, std::vector<P> & Knots, int k, la::block<T> & SplineOverlap, QSOLFunc Fun, spl Spl1, spl Spl2)
+template <class T, class P, class F, class S1, class S2>
+void Overlap(quadrature::gauss<T, P> & Gauss, std::vector<P> & Knots, int k, la::block<T> & SplineOverlap, F Fun, S1 Spl1, S2 Spl2)
 {
     Overlap(Gauss, Knots, k, SplineOverlap, [&](int i, int j, real x) -> real { return Fun(x) * Spl1(k, i, x, Knots) * Spl2(k, j, x, Knots);});
 }
@@ -159,18 +665,78 @@ real EvalSplineCoef(int k, real x, std::vector<real> & Knots, std::vector<T> & S
 
 // */
 
-template<class T>
-real EvalSplineCoef(int k, real x, std::vector<real> & Knots, std::vector<T> & SplineCoef)
+//Knot span with Knots[Span] <= x < Knots[Span+1], from the spans covered by a full set of Ns splines, [k-1, Ns-1].
+//The right end point goes in the last non-empty span and -1 is returned outside the range.
+inline int FindSpan(int k, real x, std::vector<real> & Knots, int Ns)
 {
-     real Sum = 0.0;
+    if (Ns < k || x < Knots[k-1] || x > Knots[Ns])
+        return -1;
+    int Span = int(std::upper_bound(Knots.begin() + k-1, Knots.begin() + Ns + 1, x) - Knots.begin()) - 1;
+    while (Span >= k-1 && (Span == Ns || Knots[Span] == Knots[Span+1]))
+        Span--;
+    return (Span >= k-1 ? Span : -1);
+}
+//For increasing points, walks on from the previous span and only falls back to the binary search when x goes backwards.
+inline int FindSpan(int k, real x, std::vector<real> & Knots, int Ns, int Hint)
+{
+    if (Hint < k-1 || x < Knots[Hint] || x > Knots[Ns])
+        return FindSpan(k, x, Knots, Ns);
+    while (Hint+1 < Ns && Knots[Hint+1] <= x)
+        Hint++;
+    while (Knots[Hint] == Knots[Hint+1] && Hint > k-1)
+        Hint--;
+    return Hint;
+}
 
-    size_t j = k-1;
-    while ((Knots[j] > x || (Knots[j+1] < x)) && j+1 < SplineCoef.size()) j++;
+template<class T>
+T EvalSplineCoef(int k, real x, std::vector<real> & Knots, std::vector<T> & SplineCoef)
+{
+    T Sum = T(0);
+    int Span = FindSpan(k, x, Knots, SplineCoef.size());
+    if (Span < 0)
+        return Sum;
 
-    for (int i = j-k+1; i < std::min(j+k-1, SplineCoef.size()); i++)
-        Sum += BSpline(k, i, x, Knots) * SplineCoef[i];
+    real B[MaxOrder];
+    ActiveBSplines(k, Span, x, Knots, B);
+    for (int r = 0; r < k; r++)
+        Sum += B[r] * SplineCoef[Span-k+1+r];
     return Sum;
 }
+//Batched version for whole grids, each point costs a span search and one pass of de Boor. Sorted input is swept
+//rather than searched, each thread keeps its own position. Derivatives are filled in when DValues is given.
+template<class T>
+void EvalSplineCoef(int k, std::vector<real> & X, std::vector<real> & Knots, std::vector<T> & SplineCoef, std::vector<T> & Values, std::vector<T> * DValues = nullptr)
+{
+    int Ns = SplineCoef.size();
+    int Np = X.size();
+    Values.resize(Np);
+    if (DValues)
+        DValues->resize(Np);
+
+#pragma omp parallel shared(X, Knots, SplineCoef, Values, DValues) firstprivate(k, Ns, Np) default(none)
+    {
+        int Span = -1;
+        real B[MaxOrder], DB[MaxOrder];
+#pragma omp for schedule(static)
+        for (int p = 0; p < Np; p++)
+        {
+            Span = (Span < 0 ? FindSpan(k, X[p], Knots, Ns) : FindSpan(k, X[p], Knots, Ns, Span));
+            T Val = T(0), DVal = T(0);
+            if (Span >= 0)
+            {
+                ActiveBSplines(k, Span, X[p], Knots, B, DValues ? DB : nullptr);
+                for (int r = 0; r < k; r++)
+                    Val += B[r] * SplineCoef[Span-k+1+r];
+                if (DValues)
+                    for (int r = 0; r < k; r++)
+                        DVal += DB[r] * SplineCoef[Span-k+1+r];
+            }
+            Values[p] = Val;
+            if (DValues)
+                (*DValues)[p] = DVal;
+        }
+    }
+}
 }
 }
 #endif
@@ -0,0 +1,170 @@
+/* Cathal O Broin - cathal.obroin4 at mail.dcu.ie - 2015
+   This work is not developed in affiliation with any organisation.
+
+   This file is part of AILM.
+
+   AILM is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   AILM is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with AILM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CATHAL_PROP_CHEBYSHEV_GUARD
+#define CATHAL_PROP_CHEBYSHEV_GUARD
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <algorithm>
+#include <utility>
+#include <limits>
+#include "numeric/type.h"
+#include "util/error.h"
+#include "la/array.h"
+#include "la/vec.h"
+#include "la/krylov.h"
+
+namespace cathal
+{
+namespace prop
+{
+//J_0(x) ... J_K(x) by Miller's backward recurrence, normalised with J_0 + 2 (J_2 + J_4 + ...) = 1. K is the first
+//order past x with 2 |J_K| < Tol, beyond which the terms only get smaller.
+template <class T>
+std::vector<T> BesselSequence(T x, T Tol)
+{
+    if (x == T(0))
+        return std::vector<T>(1, T(1));
+    //Start well past the turning point at k = x, where J_k decays faster than exponentially.
+    size_t M = 2 * (size_t(x + T(10) * std::cbrt(x)) / 2) + 60;
+    std::vector<T> J(M+2, T(0));
+    J[M] = T(1e-300);
+    for (size_t k = M; k > 0; k--)
+    {
+        J[k-1] = T(2) * k / x * J[k] - J[k+1];
+        if (std::abs(J[k-1]) > T(1e200))
+            for (size_t q = k-1; q <= M; q++)
+                J[q] *= T(1e-200);
+    }
+    T Sum = J[0];
+    for (size_t k = 2; k <= M; k += 2)
+        Sum += T(2) * J[k];
+    size_t K = 0;
+    while (K < M && (K < x || T(2) * std::abs(J[K] / Sum) >= Tol))
+        K++;
+    J.resize(K+1);
+    for (auto & j : J)
+        j /= Sum;
+    return J;
+}
+
+/*
+    exp(-i H dt) psi = exp(-i c dt) sum_k a_k T_k((H - c) / r) psi with a_0 = J_0(r dt), a_k = 2 (-i)^k J_k(r dt),
+    for a spectrum in [c - r, c + r]. The terms fall off super-exponentially once k > r dt, so one large step with
+    about r dt + O((r dt)^1/3) matvecs replaces many small ones whenever H is constant over the step (field free,
+    or a piecewise constant field). Only matvecs and vector updates are needed, no inner products. The bounds
+    come from a few Lanczos steps, widened slightly since the series diverges outside [-1, 1].
+*/
+template <class T=real, class U=std::complex<T> >
+class chebyshev
+{
+    T Tol;
+    T EMin = 0, EMax = 0;
+    T LastDt = -1;
+    std::vector<U> Coef;
+    la::vec<U> Phi[3]; //T_k-1, T_k and T_k+1 applied to psi, in rotation.
+
+    //Next = 2 (H - c) / r Cur - Prev, or (H - c) / r Cur for the first term.
+    void Recur(la::sqrarray<T, U> & H, la::vec<U> & Prev, la::vec<U> & Cur, la::vec<U> & Next, bool First)
+    {
+        T c = (EMax + EMin) / T(2), r = (EMax - EMin) / T(2);
+        Next = la::slice<U>(H * Cur);
+        int Sz = Cur.Size();
+        T Factor = (First ? T(1) : T(2)) / r;
+#pragma omp parallel for shared(Prev, Cur, Next) firstprivate(Sz, Factor, c, First) default(none) if(Sz > 2000)
+        for (int i = 0; i < Sz; i++)
+            Next(i) = Factor * (Next(i) - c * Cur(i)) - (First ? U(0) : Prev(i));
+    }
+
+    public :
+    //Spectral bounds from Steps Lanczos steps on H.
+    chebyshev(la::sqrarray<T, U> & H, T Tol = T(1e-12), size_t Steps = 20) : Tol(Tol)
+    {
+        Estimate(H, Steps);
+    }
+    //Known bounds.
+    chebyshev(T EMin, T EMax, T Tol = T(1e-12)) : Tol(Tol), EMin(EMin), EMax(EMax)
+    {
+        if (!(EMax > EMin))
+            throw(DIM_MISMATCH);
+    }
+    void Estimate(la::sqrarray<T, U> & H, size_t Steps = 20)
+    {
+        la::lanczos<T, U> Lan(H, std::max(Steps, size_t(2)));
+        std::pair<T, T> B = Lan.Bounds();
+        T Margin = std::max(T(0.01) * (B.second - B.first), std::numeric_limits<T>::epsilon() * std::max(std::abs(B.first), std::abs(B.second)) * T(100));
+        EMin = B.first - Margin;
+        EMax = B.second + Margin;
+        if (!(EMax > EMin))
+            EMax = EMin + T(1);
+        LastDt = -1;
+    }
+    std::pair<T, T> Bounds()
+    {
+        return std::make_pair(EMin, EMax);
+    }
+    //Number of terms in the expansion of the last step.
+    size_t Order()
+    {
+        return Coef.size();
+    }
+    //Psi -> exp(-i H Dt) Psi in one step, H must stay inside the bounds.
+    void Step(la::sqrarray<T, U> & H, la::vec<U> & Psi, T Dt)
+    {
+        T c = (EMax + EMin) / T(2), r = (EMax - EMin) / T(2);
+        if (Dt != LastDt)
+        {
+            std::vector<T> J = BesselSequence(r * std::abs(Dt), Tol);
+            Coef.resize(J.size());
+            U Phase = std::exp(U(0, -c * Dt)), MinusI = U(0, (Dt < 0 ? 1 : -1));
+            U Power = U(1);
+            for (size_t k = 0; k < J.size(); k++)
+            {
+                Coef[k] = (k ? T(2) : T(1)) * Power * J[k] * Phase;
+                Power *= MinusI;
+            }
+            LastDt = Dt;
+        }
+        int Sz = Psi.Size();
+        for (auto & p : Phi)
+            if (p.Index() != Psi.Index())
+                p.Resize(Psi.Index());
+
+        Phi[0] = la::slice<U>(Psi);
+        std::vector<U> Out(Sz);
+        U a = Coef[0];
+        for (int i = 0; i < Sz; i++)
+            Out[i] = a * Phi[0](i);
+        for (size_t k = 1; k < Coef.size(); k++)
+        {
+            la::vec<U> & Cur = Phi[(k+2) % 3];
+            la::vec<U> & Next = Phi[k % 3];
+            Recur(H, Phi[(k+1) % 3], Cur, Next, k == 1);
+            a = Coef[k];
+#pragma omp parallel for shared(Out, Next) firstprivate(Sz, a) default(none) if(Sz > 2000)
+            for (int i = 0; i < Sz; i++)
+                Out[i] += a * Next(i);
+        }
+        for (int i = 0; i < Sz; i++)
+            Psi(i) = Out[i];
+    }
+};
+}
+}
+#endif
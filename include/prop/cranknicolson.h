@@ -0,0 +1,110 @@
+/* Cathal O Broin - cathal.obroin4 at mail.dcu.ie - 2015
+   This work is not developed in affiliation with any organisation.
+
+   This file is part of AILM.
+
+   AILM is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   AILM is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with AILM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CATHAL_CRANK_NICOLSON_GUARD
+#define CATHAL_CRANK_NICOLSON_GUARD
+#include <vector>
+#include <memory>
+#include <complex>
+#include "numeric/type.h"
+#include "util/error.h"
+#include "la/array.h"
+#include "la/factor.h"
+
+namespace cathal
+{
+namespace prop
+{
+/*
+    Crank-Nicolson in a non-orthogonal basis, (S + i dt/2 H) psi(t+dt) = (S - i dt/2 H) psi(t) with
+    H = H0 + F V for a field (or any scalar) F taken at the middle of the step. Unconditionally stable and
+    O(N k^2) per step. The right hand side is one banded sweep over S, H0 and V without forming the matrix,
+    and factors are cached: one for F = 0 (field free stretches) and one for the last non-zero F, so a fixed
+    dt and an unchanged F cost only the two substitutions.
+*/
+template <class T=real>
+class cranknicolson
+{
+    typedef std::complex<T> C;
+    la::band<T> S, H0, V;
+    T Dt;
+    std::unique_ptr<la::bandlu<C> > Free, Last;
+    T LastField = 0;
+    std::vector<C> Rhs;
+
+    la::bandlu<C> * Factor(T Field)
+    {
+        std::unique_ptr<la::bandlu<C> > & Slot = (Field == T(0) ? Free : Last);
+        if (!Slot || (Field != T(0) && Field != LastField))
+        {
+            int N = S.Row(), k = S.Order();
+            la::band<C> A(N, k);
+            C Half(0, Dt/T(2));
+            for (size_t i = 0; i < A.NumElem(); i++)
+                A(i) = S(i) + Half * (H0(i) + Field * V(i));
+            Slot.reset(new la::bandlu<C>(A));
+            if (Field != T(0))
+                LastField = Field;
+        }
+        return Slot.get();
+    }
+
+    public :
+    cranknicolson(la::band<T> & S, la::band<T> & H0, la::band<T> & V, T Dt) : S(S), H0(H0), V(V), Dt(Dt), Rhs(S.Row())
+    {
+        if (H0.Row() != S.Row() || V.Row() != S.Row() || H0.Order() != S.Order() || V.Order() != S.Order())
+            throw(SIZE_MISMATCH);
+    }
+    T TimeStep()
+    {
+        return Dt;
+    }
+    //Changing dt throws away the cached factors.
+    void SetTimeStep(T NewDt)
+    {
+        if (NewDt != Dt)
+        {
+            Dt = NewDt;
+            Free.reset();
+            Last.reset();
+        }
+    }
+    //psi(t) -> psi(t+dt), Field is F at t+dt/2.
+    void Propagate(std::vector<C> & Psi, T Field = 0)
+    {
+        int N = S.Row(), k = S.Order();
+        if (Psi.size() != size_t(N))
+            throw(SIZE_MISMATCH);
+        la::bandlu<C> * LU = Factor(Field);
+
+        C Half(0, Dt/T(2));
+#pragma omp parallel for shared(Psi) firstprivate(N, k, Half, Field) default(none) if(N > 2000)
+        for (int i = 0; i < N; i++)
+        {
+            C Sum = C(0);
+            for (int j = std::max(0, i-k+1); j < std::min(N, i+k); j++)
+                Sum += (S(i, j) - Half * (H0(i, j) + Field * V(i, j))) * Psi[j];
+            Rhs[i] = Sum;
+        }
+        LU->Solve(Rhs);
+        std::swap(Psi, Rhs);
+    }
+};
+}
+}
+#endif
@@ -0,0 +1,291 @@
+/* Cathal O Broin - cathal.obroin4 at mail.dcu.ie - 2015
+   This work is not developed in affiliation with any organisation.
+
+   This file is part of AILM.
+
+   AILM is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   AILM is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with AILM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CATHAL_PROP_EIGENBASIS_GUARD
+#define CATHAL_PROP_EIGENBASIS_GUARD
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <functional>
+#include "numeric/type.h"
+#include "util/error.h"
+#include "la/array.h"
+#include "la/vec.h"
+#include "prop/krylov.h"
+
+namespace cathal
+{
+namespace prop
+{
+//F D for the length gauge dipole in the field free eigenbasis. D[l] is the l, l+1 block (N_l x N_l+1), the
+//l+1, l blocks are its transpose, kept separately so that both products run along rows. Every channel block of
+//the result is written by one thread (sqrarray's product assigns each block, so it can't sum the two
+//neighbours of a channel).
+template <class T=real>
+class dipole
+{
+    typedef std::complex<T> C;
+    std::vector<la::fullblock<T> > Up, Down;
+
+    public :
+    T Field = T(1);
+    dipole(std::vector<la::fullblock<T> > & D) : Up(D)
+    {
+        for (size_t l = 0; l < D.size(); l++)
+        {
+            if (l+1 < D.size() && D[l].Column() != D[l+1].Row())
+                throw(SIZE_MISMATCH);
+            Down.emplace_back(D[l].Column(), D[l].Row());
+            for (size_t i = 0; i < D[l].Row(); i++)
+                for (size_t j = 0; j < D[l].Column(); j++)
+                    Down[l](j, i) = D[l](i, j);
+        }
+    }
+    size_t Channels()
+    {
+        return Up.size() + 1;
+    }
+    la::vec<C> operator*(la::vec<C> & B)
+    {
+        la::vec<C> A(B.Index());
+        int L = B.Blocks();
+        if (size_t(L) != Channels())
+            throw(BLOCK_MISMATCH);
+        std::vector<size_t> Offset(L+1, 0);
+        for (int l = 0; l < L; l++)
+            Offset[l+1] = Offset[l] + B.Index()[l];
+        T F = Field;
+
+#pragma omp parallel for shared(A, B, Offset) firstprivate(L, F) default(none) schedule(dynamic)
+        for (int l = 0; l < L; l++)
+        {
+            C * a = &A(Offset[l]);
+            size_t Nl = Offset[l+1] - Offset[l];
+            if (Nl == 0)
+                continue;
+            for (size_t n = 0; n < Nl; n++)
+                a[n] = C(0);
+            if (l+1 < L && Up[l].NumElem())
+            {
+                const C * b = &B(Offset[l+1]);
+                for (size_t n = 0; n < Nl; n++)
+                {
+                    const T * d = &Up[l](n, 0);
+                    C Sum = C(0);
+                    for (size_t m = 0; m < Up[l].Column(); m++)
+                        Sum += d[m] * b[m];
+                    a[n] += F * Sum;
+                }
+            }
+            if (l > 0 && Down[l-1].NumElem())
+            {
+                const C * b = &B(Offset[l-1]);
+                for (size_t n = 0; n < Nl; n++)
+                {
+                    const T * d = &Down[l-1](n, 0);
+                    C Sum = C(0);
+                    for (size_t m = 0; m < Down[l-1].Column(); m++)
+                        Sum += d[m] * b[m];
+                    a[n] += F * Sum;
+                }
+            }
+        }
+        return A;
+    }
+};
+
+/*
+    TDSE in the field free eigenbasis, H(t) = E + F(t) D with E diagonal. Strang splitting,
+    psi(t+dt) = exp(-i E dt/2) exp(-i F(t+dt/2) D dt) exp(-i E dt/2) psi(t), so the energies only ever enter
+    as exact phases (the interaction picture, c = exp(i E t) psi, without tracking the phase of every state) and
+    the stiffness of high lying states never limits the step. The coupling exponential is a short Lanczos
+    propagation of F D alone, so the work is the l <-> l+-1 dipole products, parallel over the channels.
+    Second order in dt, the splitting error is the commutator of E and F D.
+*/
+template <class T=real>
+class eigenbasis
+{
+    typedef std::complex<T> C;
+    std::vector<size_t> Index;
+    std::vector<T> Energy;
+    dipole<T> Dip;
+    krylov<T, C> Kry;
+    //Two half step phase caches, so step doubling's dt and dt/2 do not push each other out.
+    T CacheDt[2] = {0, 0};
+    std::vector<C> Half[2];
+    size_t Oldest = 0;
+    la::vec<C> Whole;
+
+    std::vector<C> & Phases(T Dt)
+    {
+        for (size_t c = 0; c < 2; c++)
+            if (CacheDt[c] == Dt && Half[c].size() == Energy.size())
+                return Half[c];
+        size_t c = Oldest;
+        Oldest = 1 - Oldest;
+        int N = Energy.size();
+        Half[c].resize(N);
+        for (int i = 0; i < N; i++)
+            Half[c][i] = std::exp(C(0, -Energy[i] * Dt / T(2)));
+        CacheDt[c] = Dt;
+        return Half[c];
+    }
+
+    public :
+    //Energy holds every channel one after another, NumStates[l] of them for channel l.
+    eigenbasis(std::vector<T> & Energy, std::vector<size_t> & NumStates, std::vector<la::fullblock<T> > & D, T Tol = T(1e-10), size_t MaxDim = 20) : Index(NumStates), Energy(Energy), Dip(D), Kry(Tol, MaxDim)
+    {
+        if (Dip.Channels() != NumStates.size())
+            throw(SIZE_MISMATCH);
+        size_t Sum = 0;
+        for (size_t l = 0; l < NumStates.size(); l++)
+        {
+            Sum += NumStates[l];
+            if (l+1 < NumStates.size() && (D[l].Row() != NumStates[l] || D[l].Column() != NumStates[l+1]))
+                throw(SIZE_MISMATCH);
+        }
+        if (Sum != Energy.size())
+            throw(SIZE_MISMATCH);
+    }
+    std::vector<size_t> & Channels()
+    {
+        return Index;
+    }
+    size_t Size()
+    {
+        return Energy.size();
+    }
+    //A zero state with the channel blocking.
+    la::vec<C> State()
+    {
+        la::vec<C> Psi(Index);
+        Psi.Set(C(0));
+        return Psi;
+    }
+    //Psi -> exp(-i E Dt) Psi.
+    void Phase(la::vec<C> & Psi, T Dt)
+    {
+        int N = Energy.size();
+#pragma omp parallel for shared(Psi) firstprivate(N, Dt) default(none) if(N > 2000)
+        for (int i = 0; i < N; i++)
+            Psi(i) *= std::exp(C(0, -Energy[i] * Dt));
+    }
+    //Psi -> exp(-i Field D Dt) Psi, returns the number of Lanczos steps it took.
+    size_t Couple(la::vec<C> & Psi, T Field, T Dt)
+    {
+        if (Field == T(0))
+            return 0;
+        Dip.Field = Field;
+        return Kry.Propagate(Dip, Psi, Dt, (Kry.NextStep() > T(0) ? std::min(Kry.NextStep(), Dt) : Dt));
+    }
+    //One step with the field taken at the middle of it, the half step phases are cached for the last two dt.
+    void Step(la::vec<C> & Psi, T Dt, T Field)
+    {
+        int N = Energy.size();
+        std::vector<C> & H = Phases(Dt);
+#pragma omp parallel for shared(Psi, H) firstprivate(N) default(none) if(N > 2000)
+        for (int i = 0; i < N; i++)
+            Psi(i) *= H[i];
+        Couple(Psi, Field, Dt);
+#pragma omp parallel for shared(Psi, H) firstprivate(N) default(none) if(N > 2000)
+        for (int i = 0; i < N; i++)
+            Psi(i) *= H[i];
+    }
+    //The step from t both whole and as two halves, Out gets the halves and Psi is left alone (for a rejected step).
+    //Returns the step doubling estimate of the error in the halves, |psi_halves - psi_whole| / (2^2 - 1) / |psi|.
+    T Doubling(la::vec<C> & Psi, la::vec<C> & Out, T t, T Dt, std::function<T(T)> & Field)
+    {
+        int N = Energy.size();
+        if (Whole.Index() != Psi.Index())
+            Whole.Resize(Psi.Index());
+        if (Out.Index() != Psi.Index())
+            Out.Resize(Psi.Index());
+        Whole = la::slice<C>(Psi);
+        Out = la::slice<C>(Psi);
+        Step(Whole, Dt, Field(t + Dt / 2));
+        Step(Out, Dt / 2, Field(t + Dt / 4));
+        Step(Out, Dt / 2, Field(t + 3 * Dt / 4));
+        T Diff = 0, Norm = 0;
+        for (int i = 0; i < N; i++)
+        {
+            Diff += std::norm(Out(i) - Whole(i));
+            Norm += std::norm(Out(i));
+        }
+        return (Norm > 0 ? std::sqrt(Diff / Norm) / T(3) : T(0));
+    }
+    //<Psi|D|Psi>, the length gauge dipole, one dipole product.
+    T Expectation(la::vec<C> & Psi)
+    {
+        T F = Dip.Field;
+        Dip.Field = T(1);
+        la::vec<C> DPsi(Psi.Index());
+        DPsi = la::slice<C>(Dip * Psi);
+        Dip.Field = F;
+        C Sum = la::Dot(Psi, DPsi);
+        return std::real(Sum);
+    }
+    //|<n|Psi>|^2 summed over each channel.
+    std::vector<T> Populations(la::vec<C> & Psi)
+    {
+        std::vector<T> Pop(Index.size(), T(0));
+        for (size_t l = 0, i = 0; l < Index.size(); l++)
+            for (size_t n = 0; n < Index[l]; n++, i++)
+                Pop[l] += std::norm(Psi(i));
+        return Pop;
+    }
+};
+
+/*
+    Past the end of the field H is diagonal, so psi(t) = exp(-i E (t - T0)) psi(T0) exactly and there is nothing
+    left to integrate. Any t is reached directly from psi(T0) (no stepping, no accumulated phase error): the state
+    costs O(N), the populations |c_n|^2 don't change and are computed once, and the dipole
+    sum_mn c_m* c_n D_mn exp(i (E_m - E_n)(t - T0)) costs one dipole product per sample.
+*/
+template <class T=real>
+class fieldfree
+{
+    typedef std::complex<T> C;
+    eigenbasis<T> & Basis;
+    la::vec<C> Start, Psi;
+    T T0;
+    std::vector<T> Pop;
+
+    public :
+    fieldfree(eigenbasis<T> & Basis, la::vec<C> & In, T T0) : Basis(Basis), Start(In.Index()), Psi(In.Index()), T0(T0)
+    {
+        Start = la::slice<C>(In);
+        Pop = Basis.Populations(Start);
+    }
+    la::vec<C> & State(T t)
+    {
+        Psi = la::slice<C>(Start);
+        Basis.Phase(Psi, t - T0);
+        return Psi;
+    }
+    std::vector<T> & Populations()
+    {
+        return Pop;
+    }
+    T Dipole(T t)
+    {
+        return Basis.Expectation(State(t));
+    }
+};
+}
+}
+#endif
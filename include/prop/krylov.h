@@ -0,0 +1,184 @@
+/* Cathal O Broin - cathal.obroin4 at mail.dcu.ie - 2015
+   This work is not developed in affiliation with any organisation.
+
+   This file is part of AILM.
+
+   AILM is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   AILM is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with AILM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef CATHAL_PROP_KRYLOV_GUARD
+#define CATHAL_PROP_KRYLOV_GUARD
+#include <vector>
+#include <complex>
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include "numeric/type.h"
+#include "util/error.h"
+#include "la/array.h"
+#include "la/vec.h"
+#include "la/eigen.h"
+
+namespace cathal
+{
+namespace prop
+{
+/*
+    Short iterative Lanczos, psi(t+dt) = exp(-i H dt) psi(t) ~ |psi| Q_m exp(-i T_m dt) e_0 with T_m the tridiagonal
+    projection of the Hermitian H onto the Krylov space of psi. The space is grown until the a-posteriori estimate
+    |psi| beta_m |[exp(-i T_m dt)]_m-1,0| of the truncation error drops below Tol, and if MaxDim is reached first
+    the step is shortened instead, which needs no new matvecs since T_m does not depend on dt. The next step is
+    suggested from the same estimate (error ~ dt^m). H is taken as given for the whole step, so a time-dependent
+    H should be built at the middle of the step. H is anything with la::vec<U> operator*(la::vec<U> &), a
+    sqrarray or an operator such as prop::dipole.
+*/
+template <class T=real, class U=std::complex<T> >
+class krylov
+{
+    T Tol;
+    size_t MaxDim, MinDim, Dim = 0;
+    T Suggested = 0;
+    std::vector<la::vec<U> > Q;
+    std::vector<T> Alpha, Beta;
+    //Spectral decomposition of the current T_m, c_j(dt) = sum_i V(j, i) exp(-i Theta_i dt) V(0, i).
+    std::vector<T> Theta;
+    la::fullblock<T> V;
+
+    void Decompose(size_t m)
+    {
+        Theta.assign(Alpha.begin(), Alpha.begin() + m);
+        std::vector<T> e(m, T(0));
+        for (size_t i = 1; i < m; i++)
+            e[i] = Beta[i-1];
+        V.Resize(m, m);
+        std::fill(&V(0), &V(0) + m*m, T(0));
+        for (size_t i = 0; i < m; i++)
+            V(i, i) = T(1);
+        la::TridiagonalQL(Theta, e, V);
+    }
+    U Coefficient(size_t j, T Dt)
+    {
+        U Sum = U(0);
+        for (size_t i = 0; i < Theta.size(); i++)
+            Sum += V(j, i) * std::exp(U(0, -Theta[i] * Dt)) * V(0, i);
+        return Sum;
+    }
+    //Error estimate for the current space, relative to |psi|. An invariant subspace (beta_m = 0) is exact.
+    T Estimate(size_t m, T Dt)
+    {
+        return (m <= Beta.size() ? Beta[m-1] * std::abs(Coefficient(m-1, Dt)) : T(0));
+    }
+
+    public :
+    krylov(T Tol = T(1e-10), size_t MaxDim = 30, size_t MinDim = 4) : Tol(Tol), MaxDim(MaxDim), MinDim(std::max(MinDim, size_t(2))), V(0, 0)
+    {
+        if (MaxDim < this->MinDim)
+            throw(DIM_MISMATCH);
+    }
+    //Step length the last error estimate suggests, 0 before the first step.
+    T NextStep()
+    {
+        return Suggested;
+    }
+    //Krylov dimension used in the last step.
+    size_t Dimension()
+    {
+        return Dim;
+    }
+    //Advances Psi by at most Dt, returns the step actually taken.
+    template <class Op>
+    T Step(Op & H, la::vec<U> & Psi, T Dt)
+    {
+        size_t Sz = Psi.Size();
+        if (Q.size() != MaxDim+1 || Q[0].Size() != Sz)
+        {
+            Q.resize(MaxDim+1);
+            for (auto & q : Q)
+                q.Resize(Psi.Index());
+        }
+        Alpha.clear();
+        Beta.clear();
+
+        Q[0] = la::slice<U>(Psi);
+        T Norm = std::real(la::Normalise(Q[0]));
+        if (Norm == T(0))
+            return Dt;
+
+        //Lanczos with full reorthogonalisation, the spaces are small.
+        size_t m = 0;
+        T Err = 0;
+        for (size_t j = 0; j < MaxDim; j++)
+        {
+            la::vec<U> & C = Q[j+1];
+            C = la::slice<U>(H * Q[j]);
+            T a = std::real(la::Dot(Q[j], C));
+            Alpha.push_back(a);
+            for (size_t r = 0; r <= j; r++)
+            {
+                U c = la::Dot(Q[r], C);
+                for (size_t i = 0; i < Sz; i++)
+                    C(i) -= c * Q[r](i);
+            }
+            T b = std::real(la::Normalise(C));
+            m = j+1;
+            bool Breakdown = (b <= std::numeric_limits<T>::epsilon() * std::max(std::abs(a), T(1)));
+            if (!Breakdown)
+                Beta.push_back(b);
+            if (m < MinDim && !Breakdown)
+                continue;
+            Decompose(m);
+            Err = Estimate(m, Dt);
+            if (Err <= Tol || Breakdown)
+                break;
+        }
+
+        //Out of dimensions, shorten the step until the estimate is met.
+        for (int It = 0; Err > Tol; It++)
+        {
+            if (It == 50)
+                throw(NOT_CONVERGED);
+            Dt *= T(0.9) * std::pow(Tol / Err, T(1) / m);
+            Err = Estimate(m, Dt);
+        }
+        Dim = m;
+        Suggested = (Err > T(0) ? Dt * std::min(T(2), T(0.9) * std::pow(Tol / Err, T(1) / m)) : T(2) * Dt);
+
+        std::vector<U> c(m);
+        for (size_t j = 0; j < m; j++)
+            c[j] = Norm * Coefficient(j, Dt);
+        for (size_t i = 0; i < Sz; i++)
+        {
+            U Sum = U(0);
+            for (size_t j = 0; j < m; j++)
+                Sum += c[j] * Q[j](i);
+            Psi(i) = Sum;
+        }
+        return Dt;
+    }
+    //Steps Psi through Time in as few steps as the tolerance allows, Dt is the first step to try. Returns the
+    //number of steps taken.
+    template <class Op>
+    size_t Propagate(Op & H, la::vec<U> & Psi, T Time, T Dt)
+    {
+        size_t Steps = 0;
+        for (T t = 0; t < Time; Steps++)
+        {
+            t += Step(H, Psi, std::min(Dt, Time - t));
+            Dt = Suggested;
+        }
+        return Steps;
+    }
+};
+}
+}
+#endif
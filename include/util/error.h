@@ -29,7 +29,10 @@ typedef enum
     DIM_MISMATCH,
     BLOCK_MISMATCH,
     OUT_OF_BOUNDS,
-    SELF_ASSIGNMENT
+    SELF_ASSIGNMENT,
+    NOT_POSITIVE_DEFINITE,
+    NOT_CONVERGED,
+    SINGULAR
 } ErrorCode;
 
 
@@ -0,0 +1,102 @@
+/* Cathal O Broin - cathal.obroin4 at mail.dcu.ie - 2015
+   This work is not developed in affiliation with any organisation.
+
+   This file is part of AILM.
+
+   AILM is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   AILM is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with AILM.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*****************************************************************
+ *
+ *  Micro benchmarks: per quadrature point overhead of the
+ *  type-erased (std::function) and templated (inlined) paths.
+ *
+ *****************************************************************/
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <algorithm>
+
+#include "numeric/type.h"
+#include "numeric/integrate.h"
+#include "numeric/splines.h"
+#include "la/array.h"
+
+using namespace cathal;
+
+template <class F>
+double Time(F Run)
+{
+    auto Start = std::chrono::steady_clock::now();
+    Run();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+}
+
+void Report(std::string Name, double Seconds, double Points)
+{
+    std::cout << std::setw(40) << std::left << Name << std::setw(12) << Seconds << " s " << 1e9*Seconds/Points << " ns/point\n";
+}
+
+int main(int argc, char ** argv)
+{
+    size_t NumKnots = argc > 1 ? atoi(argv[1]) : 2000;
+    int k = argc > 2 ? atoi(argv[2]) : 9;
+    size_t NumQuad = 1000000;
+
+    quadrature::gauss<real, real> Gauss(k);
+    std::cout << "Knots = " << NumKnots << ", k = " << k << ", Gauss order = " << Gauss.Order() << std::endl;
+
+    //Bare quadrature of a cheap integrand
+    real Sum1 = 0.0, Sum2 = 0.0;
+    std::function<real(real)> Erased = [](real x) { return x*x; };
+    double T1 = Time([&]() { for (size_t i = 0; i < NumQuad; i++) Sum1 += Gauss.Quad(real(i), real(i+1), Erased); });
+    double T2 = Time([&]() { for (size_t i = 0; i < NumQuad; i++) Sum2 += Gauss.Quad(real(i), real(i+1), [](real x) { return x*x; }); });
+    Report("Quad, std::function", T1, NumQuad*Gauss.Order());
+    Report("Quad, lambda", T2, NumQuad*Gauss.Order());
+
+    //Matrix assembly with a cheap (i, j, x) integrand, so the call overhead dominates
+    std::vector<real> Knots(NumKnots);
+    for (size_t i = 0; i < NumKnots; i++)
+        Knots[i] = i*0.1;
+    size_t No = NumKnots - k;
+    la::band<real> A(No, k), B(No, k);
+    //Quadrature points each path evaluates. The (i, j, x) integrand is integrated over 2k-1 intervals for every
+    //band entry, de Boor per point only over the k-|i-j| intervals the pair share and the table once per element.
+    double Points = 0.0, PairPoints = 0.0;
+    for (int i = 0; i < int(No); i++)
+        for (int j = std::max(0, i-k+1); j < std::min(int(No), i+k); j++)
+        {
+            Points += (2*k-1)*Gauss.Order();
+            for (int bps = std::max(i, j); bps <= std::min(std::min(i, j) + k-1, int(NumKnots) - 2); bps++)
+                if (Knots[bps] != Knots[bps+1])
+                    PairPoints += Gauss.Order();
+        }
+
+    spline::QuadFunc ErasedPair = [](int i, int j, real x) { return x*(i+j); };
+    double T3 = Time([&]() { spline::Overlap(Gauss, Knots, k, A, ErasedPair); });
+    double T4 = Time([&]() { spline::Overlap(Gauss, Knots, k, B, [](int i, int j, real x) { return x*(i+j); }); });
+    Report("Overlap, QuadFunc", T3, Points);
+    Report("Overlap, lambda", T4, Points);
+
+    //The same integrals with real splines, per point and via the tabulated assembly
+    double T5 = Time([&]() { spline::Overlap(Gauss, Knots, k, A, [](real x) { return x; }, spline::BSPLINE, spline::BSPLINE); });
+    spline::basis_table<real> Table(Gauss, Knots, k);
+    double T6 = Time([&]() { spline::Overlap(Table, B, [](real x) { return x; }, spline::BSPLINE, spline::BSPLINE); });
+    Report("Overlap, de Boor per point", T5, PairPoints);
+    Report("Overlap, basis_table", T6, double(Table.Elements())*Table.Points());
+
+    std::cout << "Checksums " << Sum1 - Sum2 << " " << A(No/2, No/2) - B(No/2, No/2) << std::endl;
+    return 0;
+}
@@ -30,6 +30,10 @@
 #include <utility>
 #include <libconfig.h++>
 #include <iomanip> //for setprecision
+#include <string>
+#include <cmath>
+#include <chrono>
+#include <numeric>
 
 #include "la/array.h"
 #include "la/vec.h"
@@ -38,6 +42,11 @@
 #include "numeric/type.h"
 #include "la/krylov.h"
 #include "numeric/splines.h"
+#include "la/eigen.h"
+#include "la/slicing.h"
+#include "numeric/matfree.h"
+#include "numeric/fedvr.h"
+#include "netcdf/put.h"
 #include "deprecated.h"
 using namespace cathal;
 void Resize(std::vector<std::vector<real> > & SplineOverlap, size_t NumKnots, size_t k)
@@ -83,52 +92,361 @@ namespace quant
 {
 namespace abinitio
 {
+//The l independent radial matrices, all assembled in a single sweep over the basis table.
+//D = <B_i|B_j'> is the only one that isn't symmetric.
 template <class T>
-la::band<T> HOverlapMatrix(quadrature::gauss<T, T> & Gauss, int l, size_t k, std::vector<T> & Knots, size_t IgnoreStart = 1, size_t IgnoreEnd = 1)
+struct radial
 {
-    size_t No = Knots.size() - k;
-    la::band<T> DivX2(No, k), DivX(No, k), H(No, k), Prod(No, k);
-
-    spline::SymmOverlap(Gauss, Knots, k, DivX2, [](real x) {return (x ? 1.0 / (x*x) : 0.0);}, spline::BSpline<real>, spline::BSpline<real>);
-    spline::SymmOverlap(Gauss, Knots, k, DivX, [](real x) {return (x ? 1.0 / x : 0.0);}, spline::BSpline<real>, spline::BSpline<real>);
-    spline::SymmOverlap(Gauss, Knots, k, H, [&Knots, k](int i, int j, real x) { return spline::DBSpline(k, i, x, Knots) * spline::DBSpline(k, j, x, Knots);});
-
-    for (size_t i = 0; i < Prod.NumElem(); i++)
-        Prod(i) = 0.5 * H(i) + 0.5*l*(l+1)*DivX2(i) - DivX(i);
-
-    if (IgnoreStart || IgnoreEnd)
-    { 
-        la::band<real> Final = Shrink(Prod, IgnoreStart, IgnoreEnd);
-        return Final;
+    la::band<T> S, DivX, DivX2, DD, R, D;
+    radial(size_t No, size_t k) : S(No, k), DivX(No, k), DivX2(No, k), DD(No, k), R(No, k), D(No, k)
+    {
+    }
+};
+template <class T>
+radial<T> RadialMatrices(spline::basis_table<T> & Table)
+{
+    radial<T> Rad(Table.Size(), Table.Order());
+    std::vector<spline::operand<T> > Ops = {
+        {&Rad.S, [](real x) {return 1.0;}, spline::BSPLINE, spline::BSPLINE, true},
+        {&Rad.DivX, [](real x) {return (x ? 1.0 / x : 0.0);}, spline::BSPLINE, spline::BSPLINE, true},
+        {&Rad.DivX2, [](real x) {return (x ? 1.0 / (x*x) : 0.0);}, spline::BSPLINE, spline::BSPLINE, true},
+        {&Rad.DD, [](real x) {return 1.0;}, spline::DBSPLINE, spline::DBSPLINE, true},
+        {&Rad.R, [](real x) {return x;}, spline::BSPLINE, spline::BSPLINE, true},
+        {&Rad.D, [](real x) {return 1.0;}, spline::BSPLINE, spline::DBSPLINE, false}};
+    spline::Assemble(Table, Ops);
+    return Rad;
+}
+//Builds H_l = 0.5 DD + 0.5 l(l+1) DivX2 - DivX for any number of l. The l independent pieces are trimmed once
+//here, so every H_l drops the same boundary splines and nothing but the sum is done per l.
+template <class T>
+class hamiltonian
+{
+    la::band<T> Kinetic, Centrifugal, Coulomb;
+    public :
+    hamiltonian(radial<T> & Rad, size_t IgnoreStart = 1, size_t IgnoreEnd = 1) : Kinetic(Shrink(Rad.DD, IgnoreStart, IgnoreEnd)),
+        Centrifugal(Shrink(Rad.DivX2, IgnoreStart, IgnoreEnd)), Coulomb(Shrink(Rad.DivX, IgnoreStart, IgnoreEnd))
+    {
+    }
+    size_t Size()
+    {
+        return Kinetic.Row();
+    }
+    size_t Order()
+    {
+        return Kinetic.Order();
+    }
+    la::band<T> operator()(int l)
+    {
+        la::band<T> H(Kinetic.Row(), Kinetic.Order());
+        Fill(l, H);
+        return H;
+    }
+    void Fill(int l, la::band<T> & H)
+    {
+        T L = 0.5*l*(l+1);
+        for (size_t i = 0; i < H.NumElem(); i++)
+            H(i) = 0.5 * Kinetic(i) + L * Centrifugal(i) - Coulomb(i);
+    }
+    //H_l for l in [LMin, LMax], one l per iteration.
+    std::vector<la::band<T> > Range(int LMin, int LMax)
+    {
+        std::vector<la::band<T> > H(std::max(LMax - LMin + 1, 0), la::band<T>(Kinetic.Row(), Kinetic.Order()));
+        int NumL = H.size();
+#pragma omp parallel for shared(H) firstprivate(LMin, NumL) default(none)
+        for (int l = 0; l < NumL; l++)
+            Fill(LMin + l, H[l]);
+        return H;
     }
-    else return Prod;
+};
+//H_l for the FE-DVR in standard form, W^-1/2 T W^-1/2 + 0.5 l(l+1)/x_i^2 - 1/x_i. The potentials are diagonal,
+//so only the points are kept for them and the overlap never appears.
+template <class T>
+class dvrhamiltonian
+{
+    la::band<T> Kinetic;
+    std::vector<T> X;
+    public :
+    dvrhamiltonian(dvr::fedvr<T> & Basis) : Kinetic(Basis.Standard([](real x) {return 0.0;})), X(Basis.Size())
+    {
+        for (size_t i = 0; i < X.size(); i++)
+            X[i] = Basis.X(i);
+    }
+    size_t Size()
+    {
+        return Kinetic.Row();
+    }
+    size_t Order()
+    {
+        return Kinetic.Order();
+    }
+    la::band<T> operator()(int l)
+    {
+        la::band<T> H(Kinetic.Row(), Kinetic.Order());
+        Fill(l, H);
+        return H;
+    }
+    void Fill(int l, la::band<T> & H)
+    {
+        T L = 0.5*l*(l+1);
+        for (size_t i = 0; i < H.NumElem(); i++)
+            H(i) = Kinetic(i);
+        for (int i = 0; i < int(X.size()); i++)
+            H(i, i) += (X[i] ? L / (X[i]*X[i]) - 1.0 / X[i] : 0.0);
+    }
+};
+//H_l applied straight from the table, for grids where the band matrices don't fit in memory.
+template <class T>
+spline::matfree<T> MatrixFreeH(spline::basis_table<T> & Table, int l, size_t IgnoreStart = 1, size_t IgnoreEnd = 1)
+{
+    real L = 0.5*l*(l+1);
+    std::vector<spline::term> Terms = {
+        {[](real x) {return 0.5;}, spline::DBSPLINE, spline::DBSPLINE},
+        {[L](real x) {return (x ? L / (x*x) - 1.0 / x : 0.0);}, spline::BSPLINE, spline::BSPLINE}};
+    return spline::matfree<T>(Table, Terms, IgnoreStart, IgnoreEnd);
+}
+template <class T>
+la::band<T> HOverlapMatrix(radial<T> & Rad, int l, size_t IgnoreStart = 1, size_t IgnoreEnd = 1)
+{
+    hamiltonian<T> Builder(Rad, IgnoreStart, IgnoreEnd);
+    return Builder(l);
 }
 template <class T>
-la::band<T> OverlapMatrix(quadrature::gauss<T, T> & Gauss, size_t k, std::vector<T> & Knots, size_t IgnoreStart = 1, size_t IgnoreEnd = 1)
+la::band<T> OverlapMatrix(radial<T> & Rad, size_t IgnoreStart = 1, size_t IgnoreEnd = 1)
 {
-    la::band<real> S(Knots.size() - k, k);
-    spline::SymmOverlap(Gauss, Knots, k, S, [](real x){return 1.0;}, spline::BSpline<real>, spline::BSpline<real>);
     if (IgnoreStart || IgnoreEnd)
     {
-        la::band<real> Final = Shrink(S, IgnoreStart, IgnoreEnd);
+        la::band<real> Final = Shrink(Rad.S, IgnoreStart, IgnoreEnd);
         return Final;
     }
-    else return S;
+    else return Rad.S;
+}
+//The lowest eigenstates of one l, C holds the spline coefficients of each state as a column.
+template <class T>
+struct channel
+{
+    std::vector<T> E;
+    la::fullblock<T> C;
+    channel() : C(0, 0)
+    {
+    }
+};
+template <class T>
+channel<T> Diagonalise(hamiltonian<T> & Builder, la::band<T> & S, int l, size_t NumStates)
+{
+    la::band<T> H = Builder(l);
+    la::fullblock<T> C(0, 0);
+    std::vector<T> E;
+    //Only a few of the states wanted, slice them out rather than solving for all of them. Windows of at most
+    //64 states keep the fully reorthogonalised Lanczos cheap.
+    if (4 * NumStates < size_t(H.Row()))
+    {
+        la::slicing<T> Slicer(H, S);
+        E = Slicer.Lowest(NumStates, C, 1 + NumStates / 64);
+    }
+    else
+        E = la::GenSymEigen(H, S, C);
+
+    channel<T> Chan;
+    size_t N = std::min(NumStates, E.size());
+    Chan.E.assign(E.begin(), E.begin() + N);
+    Chan.C.Resize(C.Row(), N);
+    for (size_t i = 0; i < C.Row(); i++)
+        for (size_t j = 0; j < N; j++)
+            Chan.C(i, j) = C(i, j);
+    return Chan;
+}
+//Angular part of the z dipole between l and l+1 (m = 0).
+inline real AngularFactor(int l)
+{
+    return (l+1) / std::sqrt(real((2*l+1)*(2*l+3)));
+}
+//Writes what prop reads. Basis.nc holds the knots, the energies of every l one after another (NumStates gives
+//how many per l) and the coefficients over the full spline basis, one state per row. Basis.<l>.<l+1>.nc holds
+//DipoleMoment = c_l C_l^T R C_l+1 and DipoleVelocity = c_l C_l^T (D + (l+1) DivX) C_l+1.
+void BasisGeneration(std::vector<real> Knots, int k, int LMax, size_t NumStates, std::string Dir, size_t IgnoreStart = 1, size_t IgnoreEnd = 1)
+{
+    quadrature::gauss<real, real> Gauss(k);
+    spline::basis_table<real> Table(Gauss, Knots, k);
+    radial<real> Rad = RadialMatrices(Table);
+    hamiltonian<real> Builder(Rad, IgnoreStart, IgnoreEnd);
+    la::band<real> S = OverlapMatrix(Rad, IgnoreStart, IgnoreEnd);
+    la::band<real> R = Shrink(Rad.R, IgnoreStart, IgnoreEnd);
+    la::band<real> D = Shrink(Rad.D, IgnoreStart, IgnoreEnd);
+    la::band<real> DivX = Shrink(Rad.DivX, IgnoreStart, IgnoreEnd);
+
+    //Every l, then every l-pair, is an independent job. Costs are similar so dynamic scheduling is enough.
+    std::vector<channel<real> > Chan(LMax+1);
+#pragma omp parallel for shared(Builder, S, Chan) firstprivate(LMax, NumStates) default(none) schedule(dynamic)
+    for (int l = 0; l <= LMax; l++)
+        Chan[l] = Diagonalise(Builder, S, l, NumStates);
+
+#pragma omp parallel for shared(R, D, DivX, Chan, Dir) firstprivate(LMax) default(none) schedule(dynamic)
+    for (int l = 0; l < LMax; l++)
+    {
+        la::band<real> Vel(D.Row(), D.Order());
+        for (size_t i = 0; i < Vel.NumElem(); i++)
+            Vel(i) = D(i) + (l+1) * DivX(i);
+
+        la::fullblock<real> Tmp(0, 0), DM(0, 0), DV(0, 0);
+        la::Gemm(R, Chan[l+1].C, Tmp);
+        la::Gemm(Chan[l].C, Tmp, DM, true);
+        la::Gemm(Vel, Chan[l+1].C, Tmp);
+        la::Gemm(Chan[l].C, Tmp, DV, true);
+        real c = AngularFactor(l);
+        for (size_t i = 0; i < DM.NumElem(); i++)
+        {
+            DM(i) *= c;
+            DV(i) *= c;
+        }
+
+        std::string Name = Dir + "Basis." + std::to_string(l) + "." + std::to_string(l+1) + ".nc";
+        nc::Create(Name);
+        nc::PutBlock(Name, "DipoleMoment", DM);
+        nc::PutBlock(Name, "DipoleVelocity", DV);
+    }
+
+    size_t No = Rad.S.Row();
+    std::vector<real> Energy;
+    std::vector<int> States;
+    for (auto & Ch : Chan)
+    {
+        Energy.insert(Energy.end(), Ch.E.begin(), Ch.E.end());
+        States.push_back(Ch.E.size());
+    }
+    la::fullblock<real> Coef(Energy.size(), No);
+    size_t Row = 0;
+    for (auto & Ch : Chan)
+        for (size_t n = 0; n < Ch.C.Column(); n++, Row++)
+            for (size_t i = 0; i < Ch.C.Row(); i++)
+                Coef(Row, IgnoreStart + i) = Ch.C(i, n);
+    std::vector<int> Order = {k};
+
+    std::string Name = Dir + "Basis.nc";
+    nc::Create(Name);
+    nc::PutVector(Name, "Knots", Knots);
+    nc::PutVector(Name, "SplineOrder", Order);
+    nc::PutVector(Name, "NumStates", States);
+    nc::PutVector(Name, "Energy1d", Energy);
+    nc::PutBlock(Name, "Coefficients", Coef);
+}
+//Operation count of the banded symmetric eigenvalue solve. Generalised is the dsbgv path (split Cholesky of S,
+//reduction to standard form, band to tridiagonal, QL without vectors), otherwise it is dsbev and only the last two.
+//Spectra wants every eigenvalue, so unlike Diagonalise it never slices and these are the only paths it takes.
+inline double BandEigenFlops(double N, double k, bool Generalised = true)
+{
+    double Cholesky = N * k * k;        //dpbstf
+    double Reduce = 6.0 * N * k * k;    //dsbgst, a rank 2k update per row
+    double Tridiag = 6.0 * N * k * k;   //dsbtrd, bulge chasing
+    double QL = 30.0 * N * N;           //dsterf, about two sweeps of 15 N per eigenvalue
+    return (Generalised ? Cholesky + Reduce : 0.0) + Tridiag + QL;
+}
+//Spectrum of one l along with what it cost, Flops from BandEigenFlops.
+struct spectrum
+{
+    int l;
+    size_t Trim, Size;
+    std::vector<real> E;
+    double Seconds, Flops;
+};
+//Solves every l in [0, LMax]. The l-dependent trimming drops LTrim more leading functions per unit of l (where
+//the centrifugal barrier keeps the states away from the origin), so problems are handed out largest first and
+//dynamically so that the small ones fill in at the end. S is null when the builder gives a standard problem.
+template <class B>
+std::vector<spectrum> Spectra(B & Builder, la::band<real> * S, int LMax, real LTrim = 0)
+{
+    size_t k = Builder.Order();
+
+    std::vector<spectrum> Spec(LMax+1);
+    for (int l = 0; l <= LMax; l++)
+    {
+        Spec[l].l = l;
+        Spec[l].Trim = std::min(size_t(LTrim * l), Builder.Size() - k);
+        Spec[l].Size = Builder.Size() - Spec[l].Trim;
+    }
+    std::vector<int> Order(LMax+1);
+    std::iota(Order.begin(), Order.end(), 0);
+    std::stable_sort(Order.begin(), Order.end(), [&Spec](int a, int b) { return Spec[a].Size > Spec[b].Size; });
+
+#pragma omp parallel for shared(Builder, S, Spec, Order) firstprivate(LMax, k) default(none) schedule(dynamic, 1)
+    for (int n = 0; n <= LMax; n++)
+    {
+        spectrum & Sp = Spec[Order[n]];
+        auto Start = std::chrono::steady_clock::now();
+
+        la::band<real> H = Builder(Sp.l);
+        if (Sp.Trim)
+            H = Shrink(H, Sp.Trim, 0);
+        if (!S)
+            Sp.E = SymBandEigenvalues(H);
+        else if (Sp.Trim)
+        {
+            la::band<real> STrim = Shrink(*S, Sp.Trim, 0);
+            Sp.E = GenSymBandEigenvalues(H, STrim);
+        }
+        else
+        {
+            la::band<real> SCopy = *S; //S is shared, the solver takes its arguments by non-const reference.
+            Sp.E = GenSymBandEigenvalues(H, SCopy);
+        }
+
+        Sp.Seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - Start).count();
+        Sp.Flops = BandEigenFlops(Sp.Size, k, S != nullptr);
+    }
+    return Spec;
+}
+std::vector<spectrum> Spectra(radial<real> & Rad, int LMax, real LTrim = 0, size_t IgnoreStart = 1, size_t IgnoreEnd = 1)
+{
+    hamiltonian<real> Builder(Rad, IgnoreStart, IgnoreEnd);
+    la::band<real> S = OverlapMatrix(Rad, IgnoreStart, IgnoreEnd);
+    return Spectra(Builder, &S, LMax, LTrim);
+}
+//FE-DVR spectra with k Lobatto points per knot interval, solved in standard form so S is never factorised.
+std::vector<spectrum> Spectra(dvr::fedvr<real> & Basis, int LMax, real LTrim = 0)
+{
+    dvrhamiltonian<real> Builder(Basis);
+    return Spectra(Builder, nullptr, LMax, LTrim);
+}
+//All of the spectra in one file (energies of every l one after another, NumStates per l) along with the report.
+void WriteSpectra(std::vector<spectrum> & Spec, std::string FileName)
+{
+    std::vector<real> Energy, Seconds, Flops;
+    std::vector<int> States, Size;
+    std::cout << std::setw(6) << "l" << std::setw(8) << "Size" << std::setw(14) << "Seconds" << std::setw(14) << "GFLOP" << std::setw(14) << "GFLOP/s" << std::endl;
+    for (auto & Sp : Spec)
+    {
+        Energy.insert(Energy.end(), Sp.E.begin(), Sp.E.end());
+        States.push_back(Sp.E.size());
+        Size.push_back(Sp.Size);
+        Seconds.push_back(Sp.Seconds);
+        Flops.push_back(Sp.Flops);
+        std::cout << std::setw(6) << Sp.l << std::setw(8) << Sp.Size << std::setw(14) << Sp.Seconds << std::setw(14) << Sp.Flops * 1e-9
+                  << std::setw(14) << (Sp.Seconds > 0 ? Sp.Flops * 1e-9 / Sp.Seconds : 0.0) << std::endl;
+    }
+    nc::Create(FileName);
+    nc::PutVector(FileName, "Energy1d", Energy);
+    nc::PutVector(FileName, "NumStates", States);
+    nc::PutVector(FileName, "Size", Size);
+    nc::PutVector(FileName, "Seconds", Seconds);
+    nc::PutVector(FileName, "Flops", Flops);
 }
 // std::pair<vec<real>, la:sqrarray<real> >
 void Hydrogen(std::vector<real> Knots, int k, int l, size_t NumKrylov, size_t IgnoreStart = 1, size_t IgnoreEnd = 1)
 {
     size_t GaussOrder = k;
     quadrature::gauss<real, real> Gauss(GaussOrder);
+    spline::basis_table<real> Table(Gauss, Knots, k);
+    radial<real> Rad = RadialMatrices(Table);
 
-    la::band<real> H = HOverlapMatrix(Gauss, l, k, Knots, IgnoreStart, IgnoreEnd);
+    la::band<real> H = HOverlapMatrix(Rad, l, IgnoreStart, IgnoreEnd);
     std::cout << "Hydrogen built\n";
     std::cout << "H.dim = ("<< H.Row() << ", " << H.Column() << ");\n";
 
-    la::band<real> S = OverlapMatrix(Gauss, k, Knots, IgnoreStart, IgnoreEnd);
+    la::band<real> S = OverlapMatrix(Rad, IgnoreStart, IgnoreEnd);
 
+    //The Krylov check uses the matrix free H, which should give the same values.
+    spline::matfree<real> HFree = MatrixFreeH(Table, l, IgnoreStart, IgnoreEnd);
     la::sqrarray<real> sqrH(1);
-    sqrH.AddBlock(0, 0, &H);
+    sqrH.AddBlock(0, 0, &HFree);
 
     std::cout << std::setprecision(15);
     std::vector<real> Eigen = GenSymBandEigenvalues(H, S);
@@ -138,7 +456,8 @@ void Hydrogen(std::vector<real> Knots, int k, int l, size_t NumKrylov, size_t Ig
         Eigen.resize(10);
     io::Print(Eigen);
 
-    la::arnoldi<real> Kry(sqrH, NumKrylov);
+    //H is symmetric, the three term recurrence holds only the tridiagonal.
+    la::lanczos<real> Kry(sqrH, NumKrylov);
     ioln("Kry");
     std::vector<real> KryValues = Kry.Eigenvalues();
     io::Print(KryValues);
@@ -186,8 +505,39 @@ int main(int argc, char ** argv)
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 ////////////                                Main                                     ///////////////
 ////////////////////////////////////////////////////////////////////////////////////////////////////
-    int l = 0;
-    quant::abinitio::Hydrogen(Knots, k, l, NumKrylov);
+    //Krylov cross check of l = 0, a subspace size of 0 on the command line turns it off.
+    if (NumKrylov)
+        quant::abinitio::Hydrogen(Knots, k, 0, NumKrylov);
+
+    int LMax = 0;
+    real LTrim = 0;
+    unsigned int NumStates = 0;
+    std::string BasisDir = "in/", SpectraFile = "Spectra.nc", Basis = "bspline";
+    Conf.lookupValue("LMax", LMax);
+    Conf.lookupValue("LTrim", LTrim);
+    Conf.lookupValue("BasisDir", BasisDir);
+    Conf.lookupValue("SpectraFile", SpectraFile);
+    Conf.lookupValue("Basis", Basis);                       //bspline or fedvr (k points per knot interval)
+
+    if (Basis == "fedvr")
+    {
+        dvr::fedvr<real> DVR(Knots, k);
+        std::vector<quant::abinitio::spectrum> Spec = quant::abinitio::Spectra(DVR, LMax, LTrim);
+        quant::abinitio::WriteSpectra(Spec, SpectraFile);
+    }
+    else
+    {
+        quadrature::gauss<real, real> Gauss(k);
+        spline::basis_table<real> Table(Gauss, Knots, k);
+        quant::abinitio::radial<real> Rad = quant::abinitio::RadialMatrices(Table);
+        std::vector<quant::abinitio::spectrum> Spec = quant::abinitio::Spectra(Rad, LMax, LTrim);
+        quant::abinitio::WriteSpectra(Spec, SpectraFile);
+    }
+
+    //Basis files for prop, only when the number of states per l is set. prop reads spline coefficients, so this
+    //always uses the B-spline basis.
+    if (Conf.lookupValue("BasisStates", NumStates))
+        quant::abinitio::BasisGeneration(Knots, k, LMax, NumStates, BasisDir);
 
     return 0;
 }
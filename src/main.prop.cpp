@@ -26,6 +26,7 @@
 #include "numeric/type.h"
 #include "la/array.h"
 #include "netcdf/get.h"
+#include "prop/eigenbasis.h"
 
 using namespace cathal;
 using std::cout;
@@ -79,53 +80,85 @@ int main(int argc, char * argv[])
 
     std::string SName = "SplineOrder";
     std::string RName = "Radius";
-
-//     la::fullblock<real> DipoleVelocity, DipoleMoment;
+    std::string NName = "NumStates";
 
     std::vector<real> Knots = nc::GetVector<real>(File, KName);
-    la::vec<real> Energy = nc::GetVec<real>(File, EName);
+    std::vector<real> Energy = nc::GetVector<real>(File, EName);
+    std::vector<int> NumStates = nc::GetVector<int>(File, NName);
     std::cout << "Knots = " << Knots.size() << std::endl;
 
-    la::fullblock<real> DipoleTest = nc::GetBlock<real>("in/Basis.0.1.nc", "DipoleMoment");
+    //Basis.<l>.<l+1>.nc holds the l, l+1 dipole block, one file per neighbouring pair of channels.
+    std::vector<size_t> States(NumStates.begin(), NumStates.end());
+    std::vector<la::fullblock<real> > Dipole;
+    for (size_t l = 0; l+1 < States.size(); l++)
+        Dipole.push_back(nc::GetBlock<real>(Dir + "Basis." + std::to_string(l) + "." + std::to_string(l+1) + ".nc", DLName));
 
-//     nc::Get(File, Energy, EName);
-//     nc::Get(File, Knots, CName);
-//     nc::Get(File, Knots, DVName);
-//     nc::Get(File, Knots, DLName);
     unsigned int GaussN = 9;
 
     libconfig::Config InternalConf; //For settings you want to change less regularly.
     InternalConf.readFile(CFile.c_str());
     InternalConf.lookupValue("QuadOrder", GaussN);
 
-    la::sqrarray<real> Hamiltonian(2);
-    Hamiltonian.AddBlock(0, 1, &DipoleTest);
-
-//////TEST//////////////////////////////////////////////////////////////////////
-    std::vector<size_t> In = {DipoleTest.Row(), DipoleTest.Column()};
-    la::vec<real> Vec1(In), Vec2(In);
-    Vec2.Set(1.0);
-    Vec1 = Hamiltonian * Vec2;
-///////////////
     libconfig::Config Conf;
     Conf.readFile(CFile.c_str());
 
     laser::field<real, real> Laser(GaussN);
     Config(Conf, Laser);
 
-    exit(0);
-    
-    int NumSteps = 1000;
-    sequences::linear seq(Laser.End, NumSteps);
+    //Start in the ground state, the lowest state of l = 0.
+    prop::eigenbasis<real> Prop(Energy, States, Dipole);
+    la::vec<std::complex<real> > Psi = Prop.State();
+    Psi(0) = 1.0;
+
+    //Steps from the step doubling error estimate, coarse wherever the field is negligible.
+    real Tolerance = 1e-7, Threshold = 1e-10, Resolution = 1.0, FirstStep = 0.01;
+    InternalConf.lookupValue("StepTolerance", Tolerance);
+    InternalConf.lookupValue("FieldThreshold", Threshold);
+    InternalConf.lookupValue("FieldResolution", Resolution);
+    InternalConf.lookupValue("FirstStep", FirstStep);
+    std::function<real(real)> Field = [&Laser](real t) { return Laser.E(t); };
+    sequences::adaptive seq(Laser.End, FirstStep, Tolerance);
+    seq.Hint(Field, Threshold, Resolution);
+
+    la::vec<std::complex<real> > Trial = Prop.State();
     real t = 0.0, Time = 0.0;
     while (!seq.End())
     {
+        Time = seq.Time();
         t = seq.Next();
+        if (seq.Quiet())
+        {
+            Prop.Step(Psi, t - Time, Field((t + Time) / 2));
+            seq.Skip();
+        }
+        else if (seq.Accept(Prop.Doubling(Psi, Trial, Time, t - Time, Field)))
+            Psi = la::slice<std::complex<real> >(Trial);
+        else
+            continue;
         real E = Laser.E(t);
         real A = Laser.A(Time, t);
-         cout << t << " " << E << " " << A << endl;
-
-        Time = t;
+        std::vector<real> Pop = Prop.Populations(Psi);
+        cout << t << " " << E << " " << A << " " << std::norm(Psi(0));
+        for (auto p : Pop)
+            cout << " " << p;
+        cout << endl;
+    }
+    cout << "Steps " << seq.Accepted() << " rejected " << seq.Rejected() << " quiet " << seq.Skipped() << endl;
+
+    //Past Laser.End H is time independent, samples of the post pulse window come from the closed form. The
+    //populations are fixed from here on, only the dipole needs work (one dipole product per sample).
+    real FreeTime = 0.0;
+    int FreeSamples = 0;
+    InternalConf.lookupValue("FreeTime", FreeTime);
+    InternalConf.lookupValue("FreeSamples", FreeSamples);
+    prop::fieldfree<real> Free(Prop, Psi, Laser.End);
+    std::vector<real> & Pop = Free.Populations();
+    for (int n = 1; n <= FreeSamples; n++)
+    {
+        real tn = Laser.End + FreeTime * n / FreeSamples;
+        cout << tn << " " << std::norm(Psi(0)) << " " << Free.Dipole(tn);
+        for (auto p : Pop)
+            cout << " " << p;
+        cout << endl;
     }
 }
-